@@ -0,0 +1,9 @@
+add_library(equaliser INTERFACE)
+
+target_sources(equaliser INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}/equaliser.cpp
+)
+
+target_include_directories(equaliser INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}
+)
@@ -0,0 +1,127 @@
+#include <math.h>
+#include "equaliser.hpp"
+
+static constexpr float Q30 = 1073741824.0f;
+
+void Equaliser::configure(const Band *bands, unsigned int count, uint32_t sample_rate) {
+    stage_count = count < MAX_BANDS ? count : MAX_BANDS;
+
+    headroom_db = 0.0f;
+    for (auto i = 0u; i < stage_count; i++) {
+        if (bands[i].type != Type::HIGH_PASS && bands[i].gain_db > headroom_db) {
+            headroom_db = bands[i].gain_db;
+        }
+    }
+    float headroom = powf(10.0f, -headroom_db / 20.0f);
+
+    for (auto i = 0u; i < stage_count; i++) {
+        const Band &band = bands[i];
+
+        // from the audio eq cookbook
+        float w0 = 2.0f * (float)M_PI * band.frequency / (float)sample_rate;
+        float cos_w0 = cosf(w0);
+        float alpha = sinf(w0) / (2.0f * band.q);
+        float A = powf(10.0f, band.gain_db / 40.0f);
+        float root_A_alpha = 2.0f * sqrtf(A) * alpha;
+
+        float b0, b1, b2, a0, a1, a2;
+        switch (band.type) {
+        case Type::HIGH_PASS:
+            b0 = (1.0f + cos_w0) / 2.0f;
+            b1 = -(1.0f + cos_w0);
+            b2 = (1.0f + cos_w0) / 2.0f;
+            a0 = 1.0f + alpha;
+            a1 = -2.0f * cos_w0;
+            a2 = 1.0f - alpha;
+            break;
+        case Type::LOW_SHELF:
+            b0 = A * ((A + 1.0f) - (A - 1.0f) * cos_w0 + root_A_alpha);
+            b1 = 2.0f * A * ((A - 1.0f) - (A + 1.0f) * cos_w0);
+            b2 = A * ((A + 1.0f) - (A - 1.0f) * cos_w0 - root_A_alpha);
+            a0 = (A + 1.0f) + (A - 1.0f) * cos_w0 + root_A_alpha;
+            a1 = -2.0f * ((A - 1.0f) + (A + 1.0f) * cos_w0);
+            a2 = (A + 1.0f) + (A - 1.0f) * cos_w0 - root_A_alpha;
+            break;
+        case Type::HIGH_SHELF:
+            b0 = A * ((A + 1.0f) + (A - 1.0f) * cos_w0 + root_A_alpha);
+            b1 = -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cos_w0);
+            b2 = A * ((A + 1.0f) + (A - 1.0f) * cos_w0 - root_A_alpha);
+            a0 = (A + 1.0f) - (A - 1.0f) * cos_w0 + root_A_alpha;
+            a1 = 2.0f * ((A - 1.0f) - (A + 1.0f) * cos_w0);
+            a2 = (A + 1.0f) - (A - 1.0f) * cos_w0 - root_A_alpha;
+            break;
+        case Type::PEAK:
+        default:
+            b0 = 1.0f + alpha * A;
+            b1 = -2.0f * cos_w0;
+            b2 = 1.0f - alpha * A;
+            a0 = 1.0f + alpha / A;
+            a1 = -2.0f * cos_w0;
+            a2 = 1.0f - alpha / A;
+            break;
+        }
+
+        // the attenuation goes in the first stage's feed forward taps
+        if (i == 0) {
+            b0 *= headroom;
+            b1 *= headroom;
+            b2 *= headroom;
+        }
+
+        // Q1.30 only goes to just under 2, big shelf boosts can go past that
+        float coefficients[5] = {b0 / a0, b1 / a0, b2 / a0, -a1 / a0, -a2 / a0};
+        for (auto c = 0u; c < 5; c++) {
+            float scaled = coefficients[c] * Q30;
+            int32_t value = scaled >= 2147483647.0f ? INT32_MAX : scaled <= -2147483648.0f ? INT32_MIN : (int32_t)lrintf(scaled);
+            stages[i].high[c] = value >> 16;
+            stages[i].low[c] = (uint32_t)value & 0xffff;
+        }
+    }
+
+    reset();
+}
+
+void Equaliser::reset() {
+    for (auto i = 0u; i < MAX_BANDS; i++) {
+        states[i][0] = State();
+        states[i][1] = State();
+    }
+}
+
+inline int16_t Equaliser::run(const Stage &stage, State &state, int32_t x) {
+    // the sum is in Q14 of the output, unsigned so it can wrap
+    uint32_t acc = state.error;
+    acc += (uint32_t)(x * stage.high[0])        + (uint32_t)((x * (int32_t)stage.low[0]) >> 16);
+    acc += (uint32_t)(state.x1 * stage.high[1]) + (uint32_t)((state.x1 * (int32_t)stage.low[1]) >> 16);
+    acc += (uint32_t)(state.x2 * stage.high[2]) + (uint32_t)((state.x2 * (int32_t)stage.low[2]) >> 16);
+    acc += (uint32_t)(state.y1 * stage.high[3]) + (uint32_t)((state.y1 * (int32_t)stage.low[3]) >> 16);
+    acc += (uint32_t)(state.y2 * stage.high[4]) + (uint32_t)((state.y2 * (int32_t)stage.low[4]) >> 16);
+
+    int32_t y = (int32_t)acc >> 14;
+    state.error = acc & 0x3fff;
+    if (y > INT16_MAX) y = INT16_MAX;
+    if (y < INT16_MIN) y = INT16_MIN;
+
+    state.x2 = state.x1;
+    state.x1 = x;
+    state.y2 = state.y1;
+    state.y1 = y;
+    return y;
+}
+
+void Equaliser::process(uint32_t *words, unsigned int frames) {
+    if (stage_count == 0) return;
+
+    for (auto i = 0u; i < frames; i++) {
+        uint32_t word = words[i];
+        int32_t left = (int16_t)(word & 0xffff);
+        int32_t right = (int16_t)(word >> 16);
+
+        for (auto s = 0u; s < stage_count; s++) {
+            left = run(stages[s], states[s][0], left);
+            right = run(stages[s], states[s][1], right);
+        }
+
+        words[i] = (uint16_t)left | ((uint32_t)(uint16_t)right << 16);
+    }
+}
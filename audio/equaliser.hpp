@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+
+// A cascade of biquad filters for evening out the response of the speaker,
+// run over each buffer of interleaved stereo on its way to the i2s.
+//
+// Coefficients are worked out in float for the stream's sample rate, once,
+// and kept in Q1.30. The M0+ has no 32x32->64 multiply, so each Q1.30
+// coefficient is split into a signed high and unsigned low 16 bits and
+// every tap is two 32-bit multiplies. Sums are allowed to wrap, only the
+// final result has to fit. The states are direct form I with 16-bit
+// history, and the bits rounded off each output are fed into the next one
+// so low frequency filters don't suffer from the truncation.
+//
+// Boosts would clip anything near full scale, so the first stage also
+// turns everything down by the largest boost in the bands. No frequency
+// then comes out louder than it went in, and the clamp on each output is
+// only for the overshoot of full scale edges.
+class Equaliser {
+    public:
+        enum class Type : uint8_t {
+            HIGH_PASS,
+            LOW_SHELF,
+            PEAK,
+            HIGH_SHELF,
+        };
+
+        struct Band {
+            Type type;
+            float frequency;    // Hz, corner or centre
+            float q;
+            float gain_db;      // ignored by HIGH_PASS
+        };
+
+        static constexpr unsigned int MAX_BANDS = 6;
+
+    private:
+        // b0, b1, b2, -a1, -a2 (a0 normalised to 1), each split in two
+        struct Stage {
+            int32_t high[5];
+            uint32_t low[5];
+        };
+
+        struct State {
+            int32_t x1 = 0, x2 = 0;
+            int32_t y1 = 0, y2 = 0;
+            uint32_t error = 0;
+        };
+
+        Stage stages[MAX_BANDS];
+        State states[MAX_BANDS][2];
+        unsigned int stage_count = 0;
+        float headroom_db = 0.0f;
+
+        static int16_t run(const Stage &stage, State &state, int32_t x);
+
+    public:
+        // works out the coefficients for the bands at the given rate, at
+        // most MAX_BANDS are used
+        void configure(const Band *bands, unsigned int count, uint32_t sample_rate);
+        void reset();
+
+        unsigned int get_stage_count() const { return stage_count; }
+        // how far the input is turned down first
+        float get_headroom_db() const { return headroom_db; }
+
+        // filter interleaved stereo frames in place, one word per frame
+        void process(uint32_t *words, unsigned int frames);
+};
@@ -17,8 +17,18 @@ target_link_libraries(picow_bt_example_common INTERFACE
     pico_btstack_classic
     pico_btstack_cyw43
     pico_btstack_sbc_decoder
+)
+
+if(USE_FREERTOS)
+target_link_libraries(picow_bt_example_common INTERFACE
+    pico_cyw43_arch_sys_freertos
+    FreeRTOS-Kernel-Heap4
+)
+else()
+target_link_libraries(picow_bt_example_common INTERFACE
     pico_cyw43_arch_threadsafe_background
 )
+endif()
 
 target_include_directories(picow_bt_example_common INTERFACE
     ${BTSTACK_CONFIG_PATH}/ # Use our own config
@@ -28,6 +38,7 @@ target_include_directories(picow_bt_example_common INTERFACE
 target_compile_definitions(picow_bt_example_common INTERFACE
     TEST_AUDIO=1
     CYW43_LWIP=0
+    CYW43_PIO_CLOCK_DIV_DYNAMIC=1 # the clock governor slows the spi as the clock goes up
     PICO_STDIO_USB_CONNECT_WAIT_TIMEOUT_MS=3000
     #WANT_HCI_DUMP=1 # This enables btstack debug
     #ENABLE_SEGGER_RTT=1
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+
+#include "auto_brightness.hpp"
+
+void AutoBrightness::init() {
+  if(running) return;
+
+  // the adc itself is brought up by Display::init()
+  adc_select_input(Display::LIGHT_SENSOR - 26);
+  hw_set_bits(&adc_hw->cs, ADC_CS_START_ONCE_BITS);
+
+  enabled = true;
+  running = add_repeating_timer_ms(-SAMPLE_INTERVAL_MS, timer_callback, this, &timer);
+}
+
+void AutoBrightness::set_enabled(bool enabled) {
+  // forget the last setting so it's put back even if the light hasn't
+  // changed since
+  if(enabled && !this->enabled) brightness = -1;
+  this->enabled = enabled;
+}
+
+bool AutoBrightness::get_enabled() {
+  return enabled;
+}
+
+uint16_t AutoBrightness::get_level() {
+  return level < 0 ? 0 : level >> 4;
+}
+
+bool AutoBrightness::timer_callback(repeating_timer_t *rt) {
+  ((AutoBrightness *)rt->user_data)->sample();
+  return true;
+}
+
+void AutoBrightness::sample() {
+  // collect the conversion started on the previous tick, it will have
+  // finished long ago so there is no need to wait for it
+  if(adc_hw->cs & ADC_CS_READY_BITS) {
+    int32_t raw = (adc_hw->result & 0xfff) << 4;
+
+    if(level < 0) {
+      level = raw;
+    }else{
+      level = level + ((raw - level) >> FILTER_SHIFT);
+    }
+  }
+
+  // and kick off the next one
+  adc_select_input(Display::LIGHT_SENSOR - 26);
+  hw_set_bits(&adc_hw->cs, ADC_CS_START_ONCE_BITS);
+
+  if(!enabled || level < 0) return;
+
+  int32_t light = level >> 4;
+  light = light < LIGHT_DARK ? LIGHT_DARK : light;
+  light = light > LIGHT_BRIGHT ? LIGHT_BRIGHT : light;
+
+  int32_t target = BRIGHTNESS_MIN + (light - LIGHT_DARK) * (BRIGHTNESS_MAX - BRIGHTNESS_MIN) / (LIGHT_BRIGHT - LIGHT_DARK);
+
+  // only move once the filtered level has wandered clear of the current
+  // setting, always allow the ends of the range to be reached
+  if(abs(target - brightness) < HYSTERESIS && target != BRIGHTNESS_MIN && target != BRIGHTNESS_MAX) return;
+  if(target == brightness) return;
+
+  brightness = target;
+  display.set_brightness(target / 256.0f);
+}
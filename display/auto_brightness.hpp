@@ -0,0 +1,52 @@
+#pragma once
+
+#include "pico/time.h"
+
+#include "display.hpp"
+
+// Ambient light driven brightness control.
+//
+// The light sensor is sampled from a hardware alarm at a low rate, one
+// conversion is started per tick and its result collected on the next, so
+// nothing ever waits on the ADC and the audio run loop is never involved.
+class AutoBrightness {
+  public:
+    static const int32_t SAMPLE_INTERVAL_MS = 100;
+
+    // raw light sensor readings mapped onto the brightness range
+    static const int32_t LIGHT_DARK         = 32;
+    static const int32_t LIGHT_BRIGHT       = 2048;
+
+    // brightness range in 1/256ths
+    static const int32_t BRIGHTNESS_MIN     = 26;
+    static const int32_t BRIGHTNESS_MAX     = 256;
+
+    // ignore changes smaller than this so the display doesn't hunt
+    static const int32_t HYSTERESIS         = 12;
+
+    // exponential moving average weight, 1 / (1 << FILTER_SHIFT)
+    static const int32_t FILTER_SHIFT       = 3;
+
+  private:
+    Display &display;
+    repeating_timer_t timer;
+
+    // filtered light level with 4 fractional bits
+    volatile int32_t level = -1;
+    volatile int32_t brightness = BRIGHTNESS_MAX;
+    volatile bool enabled = false;
+    bool running = false;
+
+    static bool timer_callback(repeating_timer_t *rt);
+    void sample();
+
+  public:
+    AutoBrightness(Display &display) : display(display) {}
+
+    void init();
+    void set_enabled(bool enabled);
+    bool get_enabled();
+
+    // filtered light sensor reading, 0-4095
+    uint16_t get_level();
+};
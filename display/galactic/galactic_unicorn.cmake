@@ -4,6 +4,7 @@ pico_generate_pio_header(display ${CMAKE_CURRENT_LIST_DIR}/galactic_unicorn.pio)
 
 target_sources(display INTERFACE
   ${CMAKE_CURRENT_LIST_DIR}/galactic_unicorn.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../auto_brightness.cpp
 )
 
 target_include_directories(display INTERFACE
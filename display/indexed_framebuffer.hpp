@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "palette.hpp"
+
+// An 8-bit indexed framebuffer for a UnicornDisplay.
+//
+// Effects draw palette indices and the palette is only applied when the
+// buffer is encoded into the bitstream by update(), so animating colours
+// (rotating or fading the palette) doesn't need the effect to redraw
+// anything. One byte per pixel, a third of an RGB framebuffer, plus the
+// 256 pre-encoded palette entries.
+//
+// Kept separate from the display so effects that draw directly to the
+// bitstream don't pay for the memory.
+template<typename Display>
+class IndexedFramebuffer {
+  public:
+    static constexpr int WIDTH  = Display::WIDTH;
+    static constexpr int HEIGHT = Display::HEIGHT;
+    static constexpr unsigned int PALETTE_SIZE = 256;
+
+  private:
+    Display &display;
+    Palette<Display, PALETTE_SIZE> palette;
+
+    uint8_t pixels[WIDTH * HEIGHT] = {0};
+    uint8_t rotation = 0;
+    unsigned int fixed = 0;
+    bool dirty = true;
+
+    // the palette entry each index is drawn with, rebuilt when the
+    // rotation changes
+    uint8_t remap[PALETTE_SIZE];
+
+    void update_remap() {
+      unsigned int span = PALETTE_SIZE - fixed;
+      for(unsigned int i = 0; i < PALETTE_SIZE; i++) {
+        remap[i] = i < fixed ? i : fixed + (i - fixed + rotation) % span;
+      }
+      dirty = true;
+    }
+
+  public:
+    IndexedFramebuffer(Display &display) : display(display), palette(display) {
+      update_remap();
+    }
+
+    void set_pixel(int x, int y, uint8_t index) {
+      if(x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return;
+      pixels[y * WIDTH + x] = index;
+      dirty = true;
+    }
+
+    uint8_t get_pixel(int x, int y) const {
+      if(x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return 0;
+      return pixels[y * WIDTH + x];
+    }
+
+    void clear(uint8_t index = 0) {
+      memset(pixels, index, sizeof(pixels));
+      dirty = true;
+    }
+
+    uint8_t *data() { dirty = true; return pixels; }
+
+    void set_palette(uint8_t index, uint8_t r, uint8_t g, uint8_t b) {
+      palette.set(index, r, g, b);
+      dirty = true;
+    }
+
+    const typename Palette<Display, PALETTE_SIZE>::Entry &get_palette(uint8_t index) const {
+      return palette.rgb(index);
+    }
+
+    // offset every index by this much when looking up the palette, so
+    // cycling colours costs nothing until the next update()
+    void set_rotation(unsigned int offset) {
+      offset %= PALETTE_SIZE - fixed;
+      if(offset == rotation) return;
+      rotation = offset;
+      update_remap();
+    }
+    void rotate_palette(int steps) {
+      int span = PALETTE_SIZE - fixed;
+      set_rotation(((rotation + steps) % span + span) % span);
+    }
+    uint8_t get_rotation() const { return rotation; }
+
+    // indices below count keep their own entry whatever the rotation, for
+    // a background or outline that shouldn't cycle with everything else.
+    // The rest rotate among themselves
+    void set_fixed(unsigned int count) {
+      count = count >= PALETTE_SIZE ? PALETTE_SIZE - 1 : count;
+      if(count == fixed) return;
+      fixed = count;
+      rotation %= PALETTE_SIZE - fixed;
+      update_remap();
+    }
+
+    // fade the whole palette, 0 (black) to 256 (full)
+    void set_fade(uint16_t level) {
+      if(level == palette.get_scale()) return;
+      palette.set_scale(level);
+      dirty = true;
+    }
+
+    // encode into the display bitstream, skipped if nothing has changed
+    // since the last update
+    void update() {
+      if(palette.refresh()) dirty = true;
+      if(!dirty) return;
+
+      const uint8_t *p = pixels;
+      for(int y = 0; y < HEIGHT; y++) {
+        for(int x = 0; x < WIDTH; x++) {
+          display.set_pixel(x, y, palette[remap[*p++]]);
+        }
+      }
+      dirty = false;
+    }
+};
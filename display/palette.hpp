@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+// A palette of colours kept pre-encoded in the display's bcd form, so
+// drawing with a palette entry is a straight copy into the bitstream.
+//
+// Entries are re-encoded when the display brightness or gamma changes, or
+// the palette is faded with set_scale(). Call refresh() once before drawing
+// each frame to pick that up, lookups don't check.
+template<typename Display, unsigned int SIZE>
+class Palette {
+  public:
+    typedef typename Display::BCDColour BCDColour;
+
+    struct Entry {
+      uint8_t r, g, b;
+    };
+
+  private:
+    Display &display;
+    uint32_t generation = 0;
+    uint16_t scale = 256;
+
+    Entry entries[SIZE] = {};
+    BCDColour encoded[SIZE];
+
+    void encode(unsigned int index) {
+      const Entry &e = entries[index];
+      encoded[index] = display.encode((e.r * scale) >> 8, (e.g * scale) >> 8, (e.b * scale) >> 8);
+    }
+
+  public:
+    Palette(Display &display) : display(display) {}
+
+    static constexpr unsigned int size() { return SIZE; }
+
+    void set(unsigned int index, uint8_t r, uint8_t g, uint8_t b) {
+      entries[index] = {r, g, b};
+      if(generation == display.get_encoding_generation()) {
+        encode(index);
+      }
+    }
+
+    // fade every entry, 0 (black) to 256 (as set)
+    void set_scale(uint16_t value) {
+      value = value > 256 ? 256 : value;
+      if(value == scale) return;
+      scale = value;
+      generation = 0;
+    }
+    uint16_t get_scale() const { return scale; }
+
+    bool refresh() {
+      uint32_t current = display.get_encoding_generation();
+      if(generation == current) return false;
+
+      generation = current;
+      for(unsigned int i = 0; i < SIZE; i++) {
+        encode(i);
+      }
+      return true;
+    }
+
+    const Entry &rgb(unsigned int index) const { return entries[index]; }
+    const BCDColour &operator[](unsigned int index) const { return encoded[index]; }
+};
@@ -0,0 +1,609 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "unicorn_geometry.hpp"
+
+// Driver for the Galactic and Cosmic Unicorn, templated on the board
+// geometry (see unicorn_geometry.hpp).
+//
+// Pixel data is stored as a stream of bits delivered in the order the PIO
+// needs to manage the shift registers, row selects, delays, and
+// latching/blanking. Everything in here is plain memory manipulation, the
+// hardware side (init, light sensor, teardown) is in unicorn_display_pico.hpp
+// so the same driver can be built for a host against a VirtualGeometry.
+template<typename Geometry>
+class UnicornDisplay {
+  public:
+    static constexpr int WIDTH  = Geometry::WIDTH;
+    static constexpr int HEIGHT = Geometry::HEIGHT;
+
+    // pin assignments
+    static constexpr uint8_t COLUMN_CLOCK           = 13;
+    static constexpr uint8_t COLUMN_DATA            = 14;
+    static constexpr uint8_t COLUMN_LATCH           = 15;
+    static constexpr uint8_t COLUMN_BLANK           = 16;
+
+    static constexpr uint8_t ROW_BIT_0              = 17;
+    static constexpr uint8_t ROW_BIT_1              = 18;
+    static constexpr uint8_t ROW_BIT_2              = 19;
+    static constexpr uint8_t ROW_BIT_3              = 20;
+
+    static constexpr uint8_t LIGHT_SENSOR           = 28;
+
+    static constexpr uint8_t MUTE                   = 22;
+
+    static constexpr uint8_t I2S_DATA               =  9;
+    static constexpr uint8_t I2S_BCLK               = 10;
+    static constexpr uint8_t I2S_LRCLK              = 11;
+
+    static constexpr uint8_t I2C_SDA                =  4;
+    static constexpr uint8_t I2C_SCL                =  5;
+
+    static constexpr uint8_t SWITCH_A               =  0;
+    static constexpr uint8_t SWITCH_B               =  1;
+    static constexpr uint8_t SWITCH_C               =  3;
+    static constexpr uint8_t SWITCH_D               =  6;
+
+    static constexpr uint8_t SWITCH_SLEEP           = 27;
+
+    static constexpr uint8_t SWITCH_VOLUME_UP       =  7;
+    static constexpr uint8_t SWITCH_VOLUME_DOWN     =  8;
+    static constexpr uint8_t SWITCH_BRIGHTNESS_UP   = 21;
+    static constexpr uint8_t SWITCH_BRIGHTNESS_DOWN = 26;
+
+    static constexpr uint32_t ROW_COUNT = Geometry::ROW_COUNT;
+    static constexpr uint32_t BCD_FRAME_COUNT = Geometry::BCD_FRAME_COUNT;
+    static constexpr uint32_t BCD_FRAME_BYTES = Geometry::BCD_FRAME_BYTES;
+    static constexpr uint32_t ROW_BYTES = BCD_FRAME_COUNT * BCD_FRAME_BYTES;
+    static constexpr uint32_t BITSTREAM_LENGTH = (ROW_COUNT * ROW_BYTES);
+
+    // A colour with brightness and gamma applied, split into the bgr bits
+    // for each bcd frame so it can be copied straight into the bitstream.
+    // Encode once and draw it as many times as needed.
+    //
+    // The colour it was encoded from is kept for drawing into a Framebuffer.
+    struct BCDColour {
+      uint8_t planes[BCD_FRAME_COUNT] = {0};
+      uint8_t r = 0, g = 0, b = 0;
+    };
+
+    // An RGB image the size of the display. Drawing can be redirected into
+    // one with capture() so that the output of effects can be composited.
+    struct Framebuffer {
+      uint8_t pixels[WIDTH * HEIGHT * 3] = {0};
+
+      uint8_t *pixel(int x, int y) { return &pixels[(y * WIDTH + x) * 3]; }
+      const uint8_t *pixel(int x, int y) const { return &pixels[(y * WIDTH + x) * 3]; }
+    };
+
+    // called from interrupt context as each frame starts scanning out
+    typedef void (*frame_callback_t)(uint32_t frame, void *data);
+
+  private:
+    uint32_t bitstream_sm = 0;
+    uint32_t bitstream_sm_offset = 0;
+    uint32_t dma_channel = 0;
+    uint32_t dma_ctrl_channel = 0;
+
+    uint16_t brightness = 256;
+    float gamma = 1.8f;
+
+    uint16_t gamma_lut[256] = {0};
+
+    // bumped whenever brightness or gamma change so anything holding
+    // encoded colours knows to re-encode them
+    volatile uint32_t encoding_generation = 1;
+
+    // must be aligned for 32bit dma transfer
+    alignas(4) uint8_t bitstream[BITSTREAM_LENGTH] = {0};
+    const uintptr_t bitstream_addr = (uintptr_t)bitstream;
+
+    // frame counters, updated from the dma interrupt each time the control
+    // channel restarts the bitstream
+    volatile uint32_t frame_count = 0;
+    volatile uint32_t frame_time_us = 0;
+    volatile uint32_t frame_period_q4 = 0;      // smoothed, in 1/16ths of a us
+    volatile frame_callback_t frame_callback = nullptr;
+    void * volatile frame_callback_data = nullptr;
+
+    volatile bool sleeping = false;
+
+    static UnicornDisplay *irq_instance;
+
+    // scan row each block of the bitstream is currently shown on, relative
+    // to its position, see scroll()
+    uint32_t row_offset = 0;
+
+    // where drawing goes instead of the bitstream, if set
+    Framebuffer *capture_target = nullptr;
+
+    // block of the bitstream currently holding the given pixel
+    uint32_t scan_block(int x, int y) const {
+      int32_t block = (int32_t)Geometry::row(x, y) - (int32_t)row_offset;
+      return block < 0 ? block + ROW_COUNT : block;
+    }
+
+    void init_bitstream();
+    void init_gamma_lut();
+    void apply_row_offset();
+    void swap_scan_rows(uint32_t block);
+    void dma_safe_abort(uint32_t channel);
+    void frame_complete(uint32_t time_us);
+    static void dma_irq_handler();
+
+  public:
+    ~UnicornDisplay();
+
+    void init();
+    void clear();
+    void update();
+    void set_pixel(int x, int y, uint8_t r, uint8_t g, uint8_t b);
+
+    // scanout timing
+    void wait_for_vsync();
+    void set_frame_callback(frame_callback_t callback, void *data = nullptr);
+    uint32_t get_frame_count() const { return frame_count; }
+    uint32_t get_frame_time_us() const { return frame_time_us; }
+    float get_refresh_rate() const;
+
+    // stop scanning out, with the leds off, when there's nothing worth
+    // showing, and start again. Drawing still goes into the bitstream while
+    // asleep and vsync doesn't wait
+    void set_sleeping(bool value);
+    bool is_sleeping() const { return sleeping; }
+
+    BCDColour encode(uint8_t r, uint8_t g, uint8_t b);
+
+    // drawing primitives, these work directly on the bitstream and are
+    // clipped to the display
+    void set_pixel(int x, int y, const BCDColour &colour);
+    void fill_rect(int x, int y, int w, int h, const BCDColour &colour);
+    void fill_rect(int x, int y, int w, int h, uint8_t r, uint8_t g, uint8_t b);
+    void draw_vline(int x, int y0, int y1, const BCDColour &colour);
+
+    // draw the set bits of a 1bpp bitmap stored as one word per column,
+    // bit 0 at the top, in a single colour
+    void blit(int x, int y, const uint32_t *columns, int w, int h, const BCDColour &colour);
+
+    // copy the pixel data of whole display rows out of the bitstream and
+    // back again, so something can be drawn over the image and taken away
+    // later. The buffer needs WIDTH * h * BCD_FRAME_COUNT bytes
+    void save_rows(int y, int h, uint8_t *buffer) const;
+    void restore_rows(int y, int h, const uint8_t *buffer);
+
+    // move the whole image down by the given number of rows (up if
+    // negative) by changing which scan row each part of the bitstream is
+    // shown on, rather than moving pixel data about. The image wraps, rows
+    // scrolled off one edge appear on the other ready to be redrawn
+    void scroll(int rows);
+
+    // redirect drawing into a framebuffer, or back to the display if null
+    void capture(Framebuffer *target) { capture_target = target; }
+
+    // read back what is currently on the display
+    void read(Framebuffer &target) const;
+
+    // draw a mix of two framebuffers to the display, from all of a (0) to
+    // all of b (256)
+    void blend(const Framebuffer &a, const Framebuffer &b, uint16_t amount);
+
+    void set_brightness(float value);
+    float get_brightness();
+    void adjust_brightness(float delta);
+
+    void set_gamma(float value);
+    float get_gamma() const { return gamma; }
+
+    uint32_t get_encoding_generation() const { return encoding_generation; }
+
+    uint16_t light();
+
+    const uint8_t *get_bitstream() const { return bitstream; }
+};
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::init_gamma_lut() {
+  // create 14-bit gamma luts
+  for(uint16_t v = 0; v < 256; v++) {
+    // gamma correct the provided 0-255 brightness value onto a
+    // 0-65535 range for the pwm counter
+    gamma_lut[v] = (uint16_t)(powf((float)(v) / 255.0f, gamma) * (float(1U << (BCD_FRAME_COUNT)) - 1.0f) + 0.5f);
+  }
+  encoding_generation = encoding_generation + 1;
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::init_bitstream() {
+  init_gamma_lut();
+
+  // initialise the bcd timing values and row selects in the bitstream
+  for(uint32_t row = 0; row < ROW_COUNT; row++) {
+    for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+      // find the offset of this row and frame in the bitstream
+      uint8_t *p = &bitstream[row * ROW_BYTES + (BCD_FRAME_BYTES * frame)];
+
+      p[0] = Geometry::ROW_PIXELS - 1;             // row pixel count
+      p[Geometry::ROW_SELECT_OFFSET] = row;        // row select
+
+      // set the number of bcd ticks for this frame
+      uint32_t bcd_ticks = (1 << frame);
+      for(uint32_t i = 0; i < Geometry::BCD_TICKS_BYTES; i++) {
+        p[Geometry::BCD_TICKS_OFFSET + i] = (bcd_ticks >> (i * 8)) & 0xff;
+      }
+    }
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::clear() {
+  if(capture_target) {
+    memset(capture_target->pixels, 0, sizeof(capture_target->pixels));
+    return;
+  }
+
+  // zero the pixel data of every row and bcd frame, leaving the row
+  // selects and timing alone
+  for(uint32_t row = 0; row < ROW_COUNT; row++) {
+    uint8_t *p = &bitstream[row * ROW_BYTES + Geometry::PIXEL_OFFSET];
+    for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+      memset(p, 0, Geometry::ROW_PIXELS);
+      p += BCD_FRAME_BYTES;
+    }
+  }
+}
+
+template<typename Geometry>
+typename UnicornDisplay<Geometry>::BCDColour UnicornDisplay<Geometry>::encode(uint8_t r, uint8_t g, uint8_t b) {
+  BCDColour colour;
+  colour.r = r;
+  colour.g = g;
+  colour.b = b;
+
+  r = (r * this->brightness) >> 8;
+  g = (g * this->brightness) >> 8;
+  b = (b * this->brightness) >> 8;
+
+  uint16_t gamma_r = gamma_lut[r];
+  uint16_t gamma_g = gamma_lut[g];
+  uint16_t gamma_b = gamma_lut[b];
+
+  // split out the bits for each of the separate bcd frames
+  for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+    uint8_t red_bit = gamma_r & 0b1;
+    uint8_t green_bit = gamma_g & 0b1;
+    uint8_t blue_bit = gamma_b & 0b1;
+
+    colour.planes[frame] = (blue_bit << 0) | (green_bit << 1) | (red_bit << 2);
+
+    gamma_r >>= 1;
+    gamma_g >>= 1;
+    gamma_b >>= 1;
+  }
+
+  return colour;
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::set_pixel(int x, int y, uint8_t r, uint8_t g, uint8_t b) {
+  if(x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return;
+
+  if(capture_target) {
+    uint8_t *p = capture_target->pixel(x, y);
+    p[0] = r; p[1] = g; p[2] = b;
+    return;
+  }
+
+  set_pixel(x, y, encode(r, g, b));
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::set_pixel(int x, int y, const BCDColour &colour) {
+  if(x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return;
+
+  if(capture_target) {
+    uint8_t *p = capture_target->pixel(x, y);
+    p[0] = colour.r; p[1] = colour.g; p[2] = colour.b;
+    return;
+  }
+
+  uint8_t *p = &bitstream[scan_block(x, y) * ROW_BYTES + Geometry::PIXEL_OFFSET + Geometry::column(x, y)];
+
+  for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+    *p = colour.planes[frame];
+    p += BCD_FRAME_BYTES;
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::fill_rect(int x, int y, int w, int h, const BCDColour &colour) {
+  if(x < 0) { w += x; x = 0; }
+  if(y < 0) { h += y; y = 0; }
+  if(x + w > WIDTH) w = WIDTH - x;
+  if(y + h > HEIGHT) h = HEIGHT - y;
+  if(w <= 0 || h <= 0) return;
+
+  if(capture_target) {
+    for(int py = y; py < y + h; py++) {
+      for(int px = x; px < x + w; px++) {
+        set_pixel(px, py, colour);
+      }
+    }
+    return;
+  }
+
+  for(int py = y; py < y + h; py++) {
+    // a span of a display row is a contiguous run of bytes in the
+    // bitstream, though it may run backwards
+    uint32_t c0 = Geometry::column(x, py);
+    uint32_t c1 = Geometry::column(x + w - 1, py);
+    uint8_t *p = &bitstream[scan_block(x, py) * ROW_BYTES + Geometry::PIXEL_OFFSET + (c0 < c1 ? c0 : c1)];
+
+    for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+      memset(p, colour.planes[frame], w);
+      p += BCD_FRAME_BYTES;
+    }
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::fill_rect(int x, int y, int w, int h, uint8_t r, uint8_t g, uint8_t b) {
+  fill_rect(x, y, w, h, encode(r, g, b));
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::draw_vline(int x, int y0, int y1, const BCDColour &colour) {
+  if(y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+  if(x < 0 || x >= WIDTH || y1 < 0 || y0 >= HEIGHT) return;
+  y0 = y0 < 0 ? 0 : y0;
+  y1 = y1 >= HEIGHT ? HEIGHT - 1 : y1;
+
+  if(capture_target) {
+    for(int y = y0; y <= y1; y++) {
+      set_pixel(x, y, colour);
+    }
+    return;
+  }
+
+  for(int y = y0; y <= y1; y++) {
+    uint8_t *p = &bitstream[scan_block(x, y) * ROW_BYTES + Geometry::PIXEL_OFFSET + Geometry::column(x, y)];
+
+    for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+      *p = colour.planes[frame];
+      p += BCD_FRAME_BYTES;
+    }
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::blit(int x, int y, const uint32_t *columns, int w, int h, const BCDColour &colour) {
+  for(int i = 0; i < w; i++) {
+    int px = x + i;
+    if(px < 0 || px >= WIDTH) continue;
+
+    uint32_t bits = columns[i];
+    for(int j = 0; bits && j < h; j++, bits >>= 1) {
+      if(bits & 1) set_pixel(px, y + j, colour);
+    }
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::save_rows(int y, int h, uint8_t *buffer) const {
+  for(int py = y; py < y + h; py++) {
+    // a display row is a contiguous run of each bcd frame, as in fill_rect
+    uint32_t c0 = Geometry::column(0, py);
+    uint32_t c1 = Geometry::column(WIDTH - 1, py);
+    const uint8_t *p = &bitstream[scan_block(0, py) * ROW_BYTES + Geometry::PIXEL_OFFSET + (c0 < c1 ? c0 : c1)];
+
+    for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+      memcpy(buffer, p, WIDTH);
+      buffer += WIDTH;
+      p += BCD_FRAME_BYTES;
+    }
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::restore_rows(int y, int h, const uint8_t *buffer) {
+  for(int py = y; py < y + h; py++) {
+    uint32_t c0 = Geometry::column(0, py);
+    uint32_t c1 = Geometry::column(WIDTH - 1, py);
+    uint8_t *p = &bitstream[scan_block(0, py) * ROW_BYTES + Geometry::PIXEL_OFFSET + (c0 < c1 ? c0 : c1)];
+
+    for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+      memcpy(p, buffer, WIDTH);
+      buffer += WIDTH;
+      p += BCD_FRAME_BYTES;
+    }
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::scroll(int rows) {
+  static_assert(Geometry::ROWS_PER_SCAN <= 2, "scroll() supports at most two rows per scan row");
+
+  if(capture_target) {
+    // no row selects to play with, so move the rows themselves
+    constexpr size_t row_length = WIDTH * 3;
+    uint8_t *pixels = capture_target->pixels;
+    uint8_t t[row_length];
+    for(; rows > 0; rows--) {
+      memcpy(t, &pixels[(HEIGHT - 1) * row_length], row_length);
+      memmove(&pixels[row_length], pixels, (HEIGHT - 1) * row_length);
+      memcpy(pixels, t, row_length);
+    }
+    for(; rows < 0; rows++) {
+      memcpy(t, pixels, row_length);
+      memmove(pixels, &pixels[row_length], (HEIGHT - 1) * row_length);
+      memcpy(&pixels[(HEIGHT - 1) * row_length], t, row_length);
+    }
+    return;
+  }
+
+  // the row leaving each group of rows that share a scan row has to move
+  // into the next group, which is a swap within the scan row it wraps on
+  for(; rows > 0; rows--) {
+    row_offset = row_offset == 0 ? ROW_COUNT - 1 : row_offset - 1;
+    if(Geometry::ROWS_PER_SCAN > 1) swap_scan_rows(scan_block(0, 0));
+  }
+
+  for(; rows < 0; rows++) {
+    row_offset = row_offset == ROW_COUNT - 1 ? 0 : row_offset + 1;
+    if(Geometry::ROWS_PER_SCAN > 1) swap_scan_rows(scan_block(0, ROW_COUNT - 1));
+  }
+
+  apply_row_offset();
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::read(Framebuffer &target) const {
+  for(int y = 0; y < HEIGHT; y++) {
+    for(int x = 0; x < WIDTH; x++) {
+      const uint8_t *p = &bitstream[scan_block(x, y) * ROW_BYTES + Geometry::PIXEL_OFFSET + Geometry::column(x, y)];
+
+      // gather the bcd bits back into pwm values
+      uint16_t pwm[3] = {0, 0, 0};
+      for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+        uint8_t bits = *p;
+        pwm[0] |= ((bits >> 2) & 0b1) << frame;
+        pwm[1] |= ((bits >> 1) & 0b1) << frame;
+        pwm[2] |= ((bits >> 0) & 0b1) << frame;
+        p += BCD_FRAME_BYTES;
+      }
+
+      uint8_t *out = target.pixel(x, y);
+      for(int c = 0; c < 3; c++) {
+        // undo the gamma lut, it only ever increases so find the largest
+        // value that gives this pwm value or less
+        int lo = 0, hi = 255;
+        while(lo < hi) {
+          int mid = (lo + hi + 1) >> 1;
+          if(gamma_lut[mid] <= pwm[c]) lo = mid; else hi = mid - 1;
+        }
+
+        // and the brightness
+        uint32_t v = brightness ? (lo << 8) / brightness : 0;
+        out[c] = v > 255 ? 255 : v;
+      }
+    }
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::blend(const Framebuffer &a, const Framebuffer &b, uint16_t amount) {
+  amount = amount > 256 ? 256 : amount;
+
+  const uint8_t *pa = a.pixels;
+  const uint8_t *pb = b.pixels;
+  for(int y = 0; y < HEIGHT; y++) {
+    for(int x = 0; x < WIDTH; x++) {
+      uint8_t r = pa[0] + (((pb[0] - pa[0]) * amount) >> 8);
+      uint8_t g = pa[1] + (((pb[1] - pa[1]) * amount) >> 8);
+      uint8_t b = pa[2] + (((pb[2] - pa[2]) * amount) >> 8);
+      pa += 3;
+      pb += 3;
+
+      set_pixel(x, y, r, g, b);
+    }
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::apply_row_offset() {
+  for(uint32_t row = 0; row < ROW_COUNT; row++) {
+    uint32_t select = row + row_offset;
+    select = select >= ROW_COUNT ? select - ROW_COUNT : select;
+
+    uint8_t *p = &bitstream[row * ROW_BYTES + Geometry::ROW_SELECT_OFFSET];
+    for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+      *p = select;
+      p += BCD_FRAME_BYTES;
+    }
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::swap_scan_rows(uint32_t block) {
+  constexpr uint32_t span = Geometry::ROW_PIXELS / 2;
+  uint8_t *p = &bitstream[block * ROW_BYTES + Geometry::PIXEL_OFFSET];
+  uint8_t t[span];
+
+  for(uint32_t frame = 0; frame < BCD_FRAME_COUNT; frame++) {
+    memcpy(t, p, span);
+    memcpy(p, p + span, span);
+    memcpy(p + span, t, span);
+    p += BCD_FRAME_BYTES;
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::set_brightness(float value) {
+  value = value < 0.0f ? 0.0f : value;
+  value = value > 1.0f ? 1.0f : value;
+  uint16_t new_brightness = floor(value * 256.0f);
+  if(new_brightness != this->brightness) {
+    this->brightness = new_brightness;
+    encoding_generation = encoding_generation + 1;
+  }
+}
+
+template<typename Geometry>
+float UnicornDisplay<Geometry>::get_brightness() {
+  return this->brightness / 255.0f;
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::adjust_brightness(float delta) {
+  this->set_brightness(this->get_brightness() + delta);
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::set_gamma(float value) {
+  value = value < 0.1f ? 0.1f : value;
+  if(value == gamma) return;
+  gamma = value;
+  init_gamma_lut();
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::update() {
+  // the bitstream is scanned out directly, so all there is to do is wait
+  // for the frame in progress to finish
+  wait_for_vsync();
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::set_frame_callback(frame_callback_t callback, void *data) {
+  frame_callback = nullptr;
+  frame_callback_data = data;
+  frame_callback = callback;
+}
+
+template<typename Geometry>
+float UnicornDisplay<Geometry>::get_refresh_rate() const {
+  uint32_t period_q4 = frame_period_q4;
+  return period_q4 ? 16000000.0f / period_q4 : 0.0f;
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::frame_complete(uint32_t time_us) {
+  uint32_t period_q4 = (time_us - frame_time_us) << 4;
+
+  // the first frame has nothing to measure against, the second seeds the
+  // filter and after that it's a simple 1/8 moving average
+  if(frame_count == 1) {
+    frame_period_q4 = period_q4;
+  }else if(frame_count > 1) {
+    frame_period_q4 = frame_period_q4 + (int32_t)(period_q4 - frame_period_q4) / 8;
+  }
+
+  frame_time_us = time_us;
+  frame_count = frame_count + 1;
+
+  frame_callback_t callback = frame_callback;
+  if(callback) callback(frame_count, frame_callback_data);
+}
@@ -0,0 +1,275 @@
+#pragma once
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+
+#include "unicorn_display.hpp"
+
+// Hardware side of UnicornDisplay, included once by each board alongside a
+// specialisation of UnicornProgram for its PIO program, eg:
+//
+// template<> struct UnicornProgram<GalacticGeometry> {
+//   static const pio_program_t *program() { return &galactic_unicorn_program; }
+//   static pio_sm_config get_default_config(uint offset) { ... }
+// };
+//
+// template class UnicornDisplay<GalacticGeometry>;
+template<typename Geometry>
+struct UnicornProgram;
+
+template<typename Geometry>
+static inline PIO unicorn_pio() {
+  return Geometry::PIO_INDEX == 0 ? pio0 : pio1;
+}
+
+// the frame interrupt uses DMA_IRQ_1, DMA_IRQ_0 belongs to the audio i2s
+static constexpr uint UNICORN_DMA_IRQ = DMA_IRQ_1;
+
+template<typename Geometry>
+UnicornDisplay<Geometry> *UnicornDisplay<Geometry>::irq_instance = nullptr;
+
+template<typename Geometry>
+void __isr UnicornDisplay<Geometry>::dma_irq_handler() {
+  UnicornDisplay *display = irq_instance;
+  if(display && dma_channel_get_irq1_status(display->dma_ctrl_channel)) {
+    dma_channel_acknowledge_irq1(display->dma_ctrl_channel);
+    display->frame_complete(time_us_32());
+  }
+}
+
+template<typename Geometry>
+UnicornDisplay<Geometry>::~UnicornDisplay() {
+  if(irq_instance == this) {
+    dma_channel_set_irq1_enabled(dma_ctrl_channel, false);
+    irq_remove_handler(UNICORN_DMA_IRQ, dma_irq_handler);
+    irq_instance = nullptr;
+  }
+
+  PIO bitstream_pio = unicorn_pio<Geometry>();
+  dma_channel_unclaim(dma_ctrl_channel); // This works now the teardown behaves correctly
+  dma_channel_unclaim(dma_channel); // This works now the teardown behaves correctly
+  pio_sm_unclaim(bitstream_pio, bitstream_sm);
+  pio_remove_program(bitstream_pio, UnicornProgram<Geometry>::program(), bitstream_sm_offset);
+}
+
+template<typename Geometry>
+uint16_t UnicornDisplay<Geometry>::light() {
+  adc_select_input(2);
+  return adc_read();
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::init() {
+  init_bitstream();
+
+  // setup light sensor adc
+  adc_init();
+  adc_gpio_init(LIGHT_SENSOR);
+
+  gpio_init(COLUMN_CLOCK); gpio_set_dir(COLUMN_CLOCK, GPIO_OUT); gpio_put(COLUMN_CLOCK, false);
+  gpio_init(COLUMN_DATA); gpio_set_dir(COLUMN_DATA, GPIO_OUT); gpio_put(COLUMN_DATA, false);
+  gpio_init(COLUMN_LATCH); gpio_set_dir(COLUMN_LATCH, GPIO_OUT); gpio_put(COLUMN_LATCH, false);
+  gpio_init(COLUMN_BLANK); gpio_set_dir(COLUMN_BLANK, GPIO_OUT); gpio_put(COLUMN_BLANK, true);
+
+  // initialise the row select, and set them to a non-visible row to avoid flashes during setup
+  gpio_init(ROW_BIT_0); gpio_set_dir(ROW_BIT_0, GPIO_OUT); gpio_put(ROW_BIT_0, true);
+  gpio_init(ROW_BIT_1); gpio_set_dir(ROW_BIT_1, GPIO_OUT); gpio_put(ROW_BIT_1, true);
+  gpio_init(ROW_BIT_2); gpio_set_dir(ROW_BIT_2, GPIO_OUT); gpio_put(ROW_BIT_2, true);
+  gpio_init(ROW_BIT_3); gpio_set_dir(ROW_BIT_3, GPIO_OUT); gpio_put(ROW_BIT_3, true);
+
+  sleep_ms(100);
+
+  // configure full output current in register 2
+
+  uint16_t reg1 = 0b1111111111001110;
+
+  // clock the register value to all but the last driver chip
+  for(uint32_t j = 0; j < Geometry::DRIVER_CHIPS - 1; j++) {
+    for(int i = 0; i < 16; i++) {
+      if(reg1 & (1U << (15 - i))) {
+        gpio_put(COLUMN_DATA, true);
+      }else{
+        gpio_put(COLUMN_DATA, false);
+      }
+      sleep_us(10);
+      gpio_put(COLUMN_CLOCK, true);
+      sleep_us(10);
+      gpio_put(COLUMN_CLOCK, false);
+    }
+  }
+
+  // clock the last chip and latch the value
+  for(int i = 0; i < 16; i++) {
+    if(reg1 & (1U << (15 - i))) {
+      gpio_put(COLUMN_DATA, true);
+    }else{
+      gpio_put(COLUMN_DATA, false);
+    }
+
+    sleep_us(10);
+    gpio_put(COLUMN_CLOCK, true);
+    sleep_us(10);
+    gpio_put(COLUMN_CLOCK, false);
+
+    if(i == 4) {
+      gpio_put(COLUMN_LATCH, true);
+    }
+  }
+  gpio_put(COLUMN_LATCH, false);
+
+  // reapply the blank as the above seems to cause a slight glow.
+  // Note, this will produce a brief flash if a visible row is selected (which it shouldn't be)
+  gpio_put(COLUMN_BLANK, false);
+  sleep_us(10);
+  gpio_put(COLUMN_BLANK, true);
+
+  gpio_init(MUTE); gpio_set_dir(MUTE, GPIO_OUT); gpio_put(MUTE, true);
+
+  // setup button inputs
+  gpio_init(SWITCH_A); gpio_pull_up(SWITCH_A);
+  gpio_init(SWITCH_B); gpio_pull_up(SWITCH_B);
+  gpio_init(SWITCH_C); gpio_pull_up(SWITCH_C);
+  gpio_init(SWITCH_D); gpio_pull_up(SWITCH_D);
+
+  gpio_init(SWITCH_SLEEP); gpio_pull_up(SWITCH_SLEEP);
+
+  gpio_init(SWITCH_BRIGHTNESS_UP); gpio_pull_up(SWITCH_BRIGHTNESS_UP);
+  gpio_init(SWITCH_BRIGHTNESS_DOWN); gpio_pull_up(SWITCH_BRIGHTNESS_DOWN);
+
+  gpio_init(SWITCH_VOLUME_UP); gpio_pull_up(SWITCH_VOLUME_UP);
+  gpio_init(SWITCH_VOLUME_DOWN); gpio_pull_up(SWITCH_VOLUME_DOWN);
+
+  // setup the pio
+  PIO bitstream_pio = unicorn_pio<Geometry>();
+  bitstream_sm = pio_claim_unused_sm(bitstream_pio, true);
+  bitstream_sm_offset = pio_add_program(bitstream_pio, UnicornProgram<Geometry>::program());
+
+  pio_gpio_init(bitstream_pio, COLUMN_CLOCK);
+  pio_gpio_init(bitstream_pio, COLUMN_DATA);
+  pio_gpio_init(bitstream_pio, COLUMN_LATCH);
+  pio_gpio_init(bitstream_pio, COLUMN_BLANK);
+
+  pio_gpio_init(bitstream_pio, ROW_BIT_0);
+  pio_gpio_init(bitstream_pio, ROW_BIT_1);
+  pio_gpio_init(bitstream_pio, ROW_BIT_2);
+  pio_gpio_init(bitstream_pio, ROW_BIT_3);
+
+  // set the blank and row pins to be high, then set all led driving pins as outputs.
+  // This order is important to avoid a momentary flash
+  const uint pins_to_set = 1 << COLUMN_BLANK | 0b1111 << ROW_BIT_0;
+  pio_sm_set_pins_with_mask(bitstream_pio, bitstream_sm, pins_to_set, pins_to_set);
+  pio_sm_set_consecutive_pindirs(bitstream_pio, bitstream_sm, COLUMN_CLOCK, 8, true);
+
+  pio_sm_config c = UnicornProgram<Geometry>::get_default_config(bitstream_sm_offset);
+
+  // osr shifts right, autopull on, autopull threshold 8
+  sm_config_set_out_shift(&c, true, true, 32);
+
+  // configure out, set, and sideset pins
+  sm_config_set_out_pins(&c, ROW_BIT_0, 4);
+  sm_config_set_set_pins(&c, COLUMN_DATA, 3);
+  sm_config_set_sideset_pins(&c, COLUMN_CLOCK);
+
+  // join fifos as only tx needed (gives 8 deep fifo instead of 4)
+  sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+
+  // setup dma transfer for pixel data to the pio
+  dma_channel = dma_claim_unused_channel(true);
+  dma_ctrl_channel = dma_claim_unused_channel(true);
+
+  dma_channel_config ctrl_config = dma_channel_get_default_config(dma_ctrl_channel);
+  channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&ctrl_config, false);
+  channel_config_set_write_increment(&ctrl_config, false);
+  channel_config_set_chain_to(&ctrl_config, dma_channel);
+
+  dma_channel_configure(
+    dma_ctrl_channel,
+    &ctrl_config,
+    &dma_hw->ch[dma_channel].read_addr,
+    &bitstream_addr,
+    1,
+    false
+  );
+
+
+  dma_channel_config config = dma_channel_get_default_config(dma_channel);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+  channel_config_set_bswap(&config, false); // byte swap to reverse little endian
+  channel_config_set_dreq(&config, pio_get_dreq(bitstream_pio, bitstream_sm, true));
+  channel_config_set_chain_to(&config, dma_ctrl_channel);
+
+  dma_channel_configure(
+    dma_channel,
+    &config,
+    &bitstream_pio->txf[bitstream_sm],
+    NULL,
+    BITSTREAM_LENGTH / 4,
+    false);
+
+  pio_sm_init(bitstream_pio, bitstream_sm, bitstream_sm_offset, &c);
+
+  pio_sm_set_enabled(bitstream_pio, bitstream_sm, true);
+
+  // the control channel completes once per pass of the bitstream, as it
+  // points the data channel back at the start, so use it to count frames
+  irq_instance = this;
+  dma_channel_set_irq1_enabled(dma_ctrl_channel, true);
+  irq_add_shared_handler(UNICORN_DMA_IRQ, dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(UNICORN_DMA_IRQ, true);
+
+  // start the control channel
+  dma_start_channel_mask(1u << dma_ctrl_channel);
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::wait_for_vsync() {
+  // may be called from either core, the interrupt only fires on the one
+  // that called init() so spin rather than wait for an event
+  uint32_t frame = frame_count;
+  while(frame_count == frame && !sleeping) {
+    tight_loop_contents();
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::set_sleeping(bool value) {
+  if(value == sleeping) return;
+
+  PIO bitstream_pio = unicorn_pio<Geometry>();
+  if(value) {
+    // the dma stalls once the pio stops asking for data, so the bitstream
+    // carries on from the same place. Blank the leds whatever the program
+    // was in the middle of
+    pio_sm_set_enabled(bitstream_pio, bitstream_sm, false);
+    pio_sm_exec(bitstream_pio, bitstream_sm, pio_encode_set(pio_pins, 0b100));
+    sleeping = true;
+  }else{
+    // measure the next frame from now rather than from before the sleep
+    frame_time_us = time_us_32();
+    sleeping = false;
+    pio_sm_set_enabled(bitstream_pio, bitstream_sm, true);
+  }
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::dma_safe_abort(uint32_t channel) {
+  // Tear down the DMA channel.
+  // This is copied from: https://github.com/raspberrypi/pico-sdk/pull/744/commits/5e0e8004dd790f0155426e6689a66e08a83cd9fc
+  uint32_t irq0_save = dma_hw->inte0 & (1u << channel);
+  hw_clear_bits(&dma_hw->inte0, irq0_save);
+
+  dma_hw->abort = 1u << channel;
+
+  // To fence off on in-flight transfers, the BUSY bit should be polled
+  // rather than the ABORT bit, because the ABORT bit can clear prematurely.
+  while (dma_hw->ch[channel].ctrl_trig & DMA_CH0_CTRL_TRIG_BUSY_BITS) tight_loop_contents();
+
+  // Clear the interrupt (if any) and restore the interrupt masks.
+  dma_hw->ints0 = 1u << channel;
+  hw_set_bits(&dma_hw->inte0, irq0_save);
+}
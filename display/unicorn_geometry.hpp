@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+
+// Geometry traits for UnicornDisplay.
+//
+// Everything that differs between the boards lives here as compile-time
+// constants so that the address maths in the driver folds down to shifts
+// and adds. row() and column() map a display coordinate onto the scan row
+// it is clocked out on and its byte offset within that row's pixel data.
+//
+// ROWS_PER_SCAN is how many display rows share a scan row, each taking an
+// equal, contiguous share of its pixel data.
+
+// Galactic Unicorn, 53x11, one scan row per display row
+//
+// for each row:
+//   for each bcd frame:
+//            0: 00110100                           // row pixel count (minus one)
+//            1: xxxxrrrr                           // row select bits
+//      2  - 54: xxxxxbgr, xxxxxbgr, xxxxxbgr, ...  // pixel data
+//           55: xxxxxxxx                           // dummy byte to dword align
+//      56 - 59: tttttttt, tttttttt, tttttttt, ...  // bcd tick count (0-65536)
+//
+//  .. and back to the start
+struct GalacticGeometry {
+  static constexpr int WIDTH  = 53;
+  static constexpr int HEIGHT = 11;
+
+  static constexpr uint32_t ROW_COUNT         = 11;
+  static constexpr uint32_t ROW_PIXELS        = 53;
+  static constexpr uint32_t BCD_FRAME_COUNT   = 14;
+  static constexpr uint32_t BCD_FRAME_BYTES   = 60;
+  static constexpr uint32_t ROW_SELECT_OFFSET = 1;
+  static constexpr uint32_t PIXEL_OFFSET      = 2;
+  static constexpr uint32_t BCD_TICKS_OFFSET  = 56;
+  static constexpr uint32_t BCD_TICKS_BYTES   = 4;
+  static constexpr uint32_t ROWS_PER_SCAN     = 1;
+
+  // pio block used for the bitstream and the number of chained driver chips
+  static constexpr uint32_t PIO_INDEX         = 1;
+  static constexpr uint32_t DRIVER_CHIPS      = 10;
+
+  static constexpr uint32_t row(int x, int y) {
+    return (HEIGHT - 1) - y;
+  }
+
+  static constexpr uint32_t column(int x, int y) {
+    return (WIDTH - 1) - x;
+  }
+};
+
+// Cosmic Unicorn, 32x32, each scan row drives one row in the top half of
+// the panel and one in the bottom half
+//
+// for each row:
+//   for each bcd frame:
+//            0: 00111111                           // row pixel count (minus one)
+//      1  - 64: xxxxxbgr, xxxxxbgr, xxxxxbgr, ...  // pixel data
+//      65 - 67: xxxxxxxx, xxxxxxxx, xxxxxxxx       // dummy bytes to dword align
+//           68: xxxxrrrr                           // row select bits
+//      69 - 71: tttttttt, tttttttt, tttttttt       // bcd tick count (0-65536)
+//
+//  .. and back to the start
+struct CosmicGeometry {
+  static constexpr int WIDTH  = 32;
+  static constexpr int HEIGHT = 32;
+
+  static constexpr uint32_t ROW_COUNT         = 16;
+  static constexpr uint32_t ROW_PIXELS        = 64;
+  static constexpr uint32_t BCD_FRAME_COUNT   = 14;
+  static constexpr uint32_t BCD_FRAME_BYTES   = 72;
+  static constexpr uint32_t ROW_SELECT_OFFSET = 68;
+  static constexpr uint32_t PIXEL_OFFSET      = 1;
+  static constexpr uint32_t BCD_TICKS_OFFSET  = 69;
+  static constexpr uint32_t BCD_TICKS_BYTES   = 3;
+  static constexpr uint32_t ROWS_PER_SCAN     = 2;
+
+  static constexpr uint32_t PIO_INDEX         = 0;
+  static constexpr uint32_t DRIVER_CHIPS      = 12;
+
+  static constexpr uint32_t row(int x, int y) {
+    return 15 - (y & 15);
+  }
+
+  // the top half of the panel is the first 32 pixels of a scan row
+  static constexpr uint32_t column(int x, int y) {
+    return (31 - x) + (y < 16 ? 0 : 32);
+  }
+};
+
+// A display that only exists in memory, laid out exactly like the board it
+// stands in for. Used to run the driver on a host for testing/benchmarking.
+template<typename Layout>
+struct VirtualGeometry : Layout {
+};
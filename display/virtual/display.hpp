@@ -0,0 +1,11 @@
+#pragma once
+
+#include "unicorn_display.hpp"
+
+// In-memory stand-in for a real board, for building and exercising the
+// driver on a host. Defaults to the Galactic Unicorn layout.
+#ifndef VIRTUAL_DISPLAY_LAYOUT
+#define VIRTUAL_DISPLAY_LAYOUT GalacticGeometry
+#endif
+
+using Display = UnicornDisplay<VirtualGeometry<VIRTUAL_DISPLAY_LAYOUT>>;
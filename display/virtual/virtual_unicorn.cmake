@@ -0,0 +1,12 @@
+add_library(virtual_display INTERFACE)
+
+target_sources(virtual_display INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}/virtual_unicorn.cpp
+)
+
+target_include_directories(virtual_display INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}
+  ${CMAKE_CURRENT_LIST_DIR}/../
+)
+
+set(DISPLAY_NAME "Virtual Unicorn")
@@ -0,0 +1,32 @@
+#include "unicorn_display.hpp"
+
+// A virtual display has no hardware to bring up, the bitstream is simply
+// left in memory for whoever wants to look at it.
+
+template<typename Geometry>
+UnicornDisplay<Geometry>::~UnicornDisplay() {
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::init() {
+  init_bitstream();
+}
+
+template<typename Geometry>
+uint16_t UnicornDisplay<Geometry>::light() {
+  return 0;
+}
+
+// there's no scanout to wait for, each wait simply counts as a frame
+template<typename Geometry>
+void UnicornDisplay<Geometry>::wait_for_vsync() {
+  frame_complete(frame_time_us);
+}
+
+template<typename Geometry>
+void UnicornDisplay<Geometry>::set_sleeping(bool value) {
+  sleeping = value;
+}
+
+template class UnicornDisplay<VirtualGeometry<GalacticGeometry>>;
+template class UnicornDisplay<VirtualGeometry<CosmicGeometry>>;
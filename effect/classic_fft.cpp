@@ -2,20 +2,16 @@
 #include "effect.hpp"
 
 void ClassicFFT::update(int16_t *buffer16, size_t sample_count) {
-    int16_t* fft_array = &fft.sample_array[SAMPLES_PER_AUDIO_BUFFER * (BUFFERS_PER_FFT_SAMPLE - 1)];
-    memmove(fft.sample_array, &fft.sample_array[SAMPLES_PER_AUDIO_BUFFER], (BUFFERS_PER_FFT_SAMPLE - 1) * sizeof(uint16_t));
-
-    for (auto i = 0u; i < SAMPLES_PER_AUDIO_BUFFER; i++) {
-        fft_array[i] = buffer16[i];
-    }
-
-    fft.update();
+    palette.refresh();
+    palette_dim.refresh();
+    const Display::BCDColour blank;
 
     for (auto i = 0u; i < display.WIDTH; i++) {
         fix15 sample = std::min(float_to_fix15(max_sample_from_fft), fft.get_scaled_as_fix15(i + FFT_SKIP_BINS));
         uint8_t maxy = 0;
 
-        for (int j = 0; j < HISTORY_LEN; ++j) {
+        bool peaks = quality < QUALITY_NO_PEAKS;
+        for (int j = 0; peaks && j < HISTORY_LEN; ++j) {
             if (eq_history[i][j] > maxy) {
                 maxy = eq_history[i][j];
             }
@@ -24,43 +20,50 @@ void ClassicFFT::update(int16_t *buffer16, size_t sample_count) {
 #ifdef SCALE_SQRT
         fix15 subtract = subtract_step;
 #endif
-        for (auto y = 0; y < display.HEIGHT; y++) {
-            uint8_t r = 0;
-            uint8_t g = 0;
-            uint8_t b = 0;
-            if (sample > int_to_fix15(lower_threshold)) {
-                r = (uint16_t)(palette[y].r);
-                g = (uint16_t)(palette[y].g);
-                b = (uint16_t)(palette[y].b);
+        // work out where each part of the bar ends first, then draw each
+        // part as a single run of pixels
+        int y = 0;
+        while (y < display.HEIGHT && sample > int_to_fix15(lower_threshold)) {
 #ifdef SCALE_LOGARITHMIC
-                sample = multiply_fix15_unit(multiple, sample);
+            sample = multiply_fix15_unit(multiple, sample);
 #else 
-                sample = std::max(1, sample - subtract);
+            sample = std::max(1, sample - subtract);
 #ifdef SCALE_SQRT
-                subtract += subtract_step;
+            subtract += subtract_step;
 #endif
 #endif
+            y++;
+        }
+        int bar_top = y;
+
+        // the top of the bar is partially lit
+        if (y < display.HEIGHT && sample > 0) {
+            uint16_t int_sample = (uint16_t)fix15_to_int(sample);
+            display.set_pixel(i, display.HEIGHT - 1 - y,
+                std::min((uint16_t)(palette.rgb(y).r), int_sample),
+                std::min((uint16_t)(palette.rgb(y).g), int_sample),
+                std::min((uint16_t)(palette.rgb(y).b), int_sample));
+            eq_history[i][history_idx] = y;
+            if (maxy < y) {
+                maxy = y;
             }
-            else if (sample > 0) {
-                uint16_t int_sample = (uint16_t)fix15_to_int(sample);
-                r = std::min((uint16_t)(palette[y].r), int_sample);
-                g = std::min((uint16_t)(palette[y].g), int_sample);
-                b = std::min((uint16_t)(palette[y].b), int_sample);
-                eq_history[i][history_idx] = y;
-                sample = 0;
-                if (maxy < y) {
-                    maxy = y;
-                }
-            } else if (y < maxy) {
-                r = (uint16_t)(palette[y].r) >> 3;
-                g = (uint16_t)(palette[y].g) >> 3;
-                b = (uint16_t)(palette[y].b) >> 3;
-            }
-            display.set_pixel(i, display.HEIGHT - 1 - y, r, g, b);
+            y++;
         }
-        if (maxy > 0) {
-            RGB c = palette[display.HEIGHT - 1];
-            display.set_pixel(i, display.HEIGHT - 1 - maxy, c.r, c.g, c.b);
+
+        for (auto row = 0; row < bar_top; row++) {
+            display.set_pixel(i, display.HEIGHT - 1 - row, palette[row]);
+        }
+        // dimmed up to the recent peak, blank above it
+        int dim_top = std::max(y, (int)maxy);
+        for (auto row = y; row < dim_top; row++) {
+            display.set_pixel(i, display.HEIGHT - 1 - row, palette_dim[row]);
+        }
+        if (dim_top < display.HEIGHT) {
+            display.draw_vline(i, 0, display.HEIGHT - 1 - dim_top, blank);
+        }
+
+        if (peaks && maxy > 0) {
+            display.set_pixel(i, display.HEIGHT - 1 - maxy, palette[display.HEIGHT - 1]);
         }
     }
     history_idx = (history_idx + 1) % HISTORY_LEN;
@@ -71,13 +74,13 @@ void ClassicFFT::init(uint32_t sample_frequency) {
 
     history_idx = 0;
 
-    fft.set_scale(display.HEIGHT * .318f);
-
     for(auto i = 0u; i < display.HEIGHT; i++) {
         int n = floor(i / 4) * 4;
         float h = 0.4 * float(n) / display.HEIGHT;
         h = 0.333 - h;
-        palette[i] = RGB::from_hsv(h, 1.0f, 1.0f);
+        RGB c = RGB::from_hsv(h, 1.0f, 1.0f);
+        palette.set(i, c.r, c.g, c.b);
+        palette_dim.set(i, c.r >> 3, c.g >> 3, c.b >> 3);
     }
 
     max_sample_from_fft = 4000.f + 130.f * display.HEIGHT;
@@ -1,32 +1,57 @@
 #pragma once
+#include <atomic>
 #include <functional>
 #include "display.hpp"
+#include "palette.hpp"
+#include "indexed_framebuffer.hpp"
 #include "lib/fixed_fft.hpp"
 #include "lib/rgb.hpp"
+#include "lib/audio_levels.hpp"
+#include "lib/particle_pool.hpp"
+#include "lib/font5x7.hpp"
 
+// Effects draw from the spectrum in fft, which EffectManager updates with
+// each new buffer before calling update()
 class Effect {
     public:
+        // Quality levels, EffectManager steps these up when an effect runs
+        // over its time budget and back down when there's headroom
+        static constexpr unsigned int QUALITY_FULL = 0;
+        static constexpr unsigned int QUALITY_NO_PEAKS = 1;   // skip peak hold
+        static constexpr unsigned int QUALITY_HALF_RATE = 2;  // update every other buffer
+        static constexpr unsigned int QUALITY_LOWEST = QUALITY_HALF_RATE;
+
         Display &display;
         FIX_FFT &fft;
+        unsigned int quality = QUALITY_FULL;
         Effect(Display& display, FIX_FFT& fft) : 
             display(display), 
             fft(fft) {};
         virtual void init(uint32_t sample_frequency);
         virtual void update(int16_t *buffer16, size_t sample_count);
+        virtual void set_quality(unsigned int level) { quality = level; }
+};
+
+// Drawn by EffectManager over whichever effect is running. Not every
+// effect redraws the whole display each update, so an overlay has to put
+// back what it covered in erase(), which is called before the effect runs.
+class Overlay {
+    public:
+        virtual void erase() = 0;
+        virtual void draw() = 0;
 };
 
 class RainbowFFT : public Effect {
     private:
         // Number of FFT bins to skip on the left, the low frequencies tend to be pretty boring visually
         static constexpr unsigned int FFT_SKIP_BINS = 1;
-        static constexpr unsigned int BUFFERS_PER_FFT_SAMPLE = 2;
-        static constexpr unsigned int SAMPLES_PER_AUDIO_BUFFER = SAMPLE_COUNT / BUFFERS_PER_FFT_SAMPLE;
         static constexpr int HISTORY_LEN = 21; // About 0.25s
         uint history_idx;
         uint8_t eq_history[Display::WIDTH][HISTORY_LEN];
 
-        RGB palette_peak[Display::WIDTH];
-        RGB palette_main[Display::WIDTH];
+        Palette<Display, Display::WIDTH> palette_peak;
+        Palette<Display, Display::WIDTH> palette_main;
+        Palette<Display, Display::WIDTH> palette_dim;
 
         float max_sample_from_fft;
         int lower_threshold;
@@ -41,7 +66,10 @@ class RainbowFFT : public Effect {
 #endif
 
     public:
-        RainbowFFT(Display& display, FIX_FFT& fft) : Effect(display, fft) {}
+        RainbowFFT(Display& display, FIX_FFT& fft) : Effect(display, fft),
+            palette_peak(display),
+            palette_main(display),
+            palette_dim(display) {}
         void update(int16_t *buffer16, size_t sample_count) override;
         void init(uint32_t sample_frequency) override;
 };
@@ -50,13 +78,12 @@ class ClassicFFT : public Effect {
     private:
         // Number of FFT bins to skip on the left, the low frequencies tend to be pretty boring visually
         static constexpr unsigned int FFT_SKIP_BINS = 1;
-        static constexpr unsigned int BUFFERS_PER_FFT_SAMPLE = 2;
-        static constexpr unsigned int SAMPLES_PER_AUDIO_BUFFER = SAMPLE_COUNT / BUFFERS_PER_FFT_SAMPLE;
         static constexpr int HISTORY_LEN = 21; // About 0.25s
         uint history_idx;
         uint8_t eq_history[Display::WIDTH][HISTORY_LEN];
 
-        RGB palette[Display::HEIGHT];
+        Palette<Display, Display::HEIGHT> palette;
+        Palette<Display, Display::HEIGHT> palette_dim;
 
         float max_sample_from_fft;
         int lower_threshold;
@@ -71,7 +98,207 @@ class ClassicFFT : public Effect {
 #endif
 
     public:
-        ClassicFFT(Display& display, FIX_FFT &fft) : Effect(display, fft) {}
+        ClassicFFT(Display& display, FIX_FFT &fft) : Effect(display, fft),
+            palette(display),
+            palette_dim(display) {}
+        void update(int16_t *buffer16, size_t sample_count) override;
+        void init(uint32_t sample_frequency) override;
+};
+
+class Waterfall : public Effect {
+    private:
+        // Number of FFT bins to skip on the left, the low frequencies tend to be pretty boring visually
+        static constexpr unsigned int FFT_SKIP_BINS = 1;
+        static constexpr unsigned int BUFFERS_PER_ROW = 3; // About 35ms of history per row
+        static constexpr unsigned int LEVELS = 32;
+
+        Palette<Display, LEVELS> palette;
+        uint8_t row_levels[Display::WIDTH];
+        unsigned int row_buffers;
+
+        int max_sample_from_fft;
+        int lower_threshold;
+
+    public:
+        Waterfall(Display& display, FIX_FFT &fft) : Effect(display, fft),
+            palette(display) {}
+        void update(int16_t *buffer16, size_t sample_count) override;
+        void init(uint32_t sample_frequency) override;
+};
+
+class VUMeter : public Effect {
+    private:
+        static constexpr float DB_MIN = -48.0f;
+        static constexpr float ATTACK = 0.5f;            // fraction of a rise taken per buffer
+        static constexpr float RELEASE = 0.1f;           // fraction of a fall taken per buffer
+        static constexpr unsigned int PEAK_HOLD = 86;    // buffers, about 1s
+        static constexpr float PEAK_FALL_DB = 0.25f;     // per buffer once the hold is over, about 20dB/s
+
+        const AudioLevels &levels;
+
+        Palette<Display, Display::WIDTH> palette_lit;
+        Palette<Display, Display::WIDTH> palette_unlit;
+        Palette<Display, 1> palette_peak;
+
+        float level_db[2];
+        float peak_db[2];
+        unsigned int peak_hold[2];
+
+        int db_to_x(float db);
+
+    public:
+        VUMeter(Display& display, FIX_FFT &fft, const AudioLevels &levels) : Effect(display, fft),
+            levels(levels),
+            palette_lit(display),
+            palette_unlit(display),
+            palette_peak(display) {}
         void update(int16_t *buffer16, size_t sample_count) override;
         void init(uint32_t sample_frequency) override;
 };
+
+class RadialFFT : public Effect {
+    private:
+        // Number of FFT bins to skip, the low frequencies tend to be pretty boring visually
+        static constexpr unsigned int FFT_SKIP_BINS = 1;
+        // Bands mirrored either side of the vertical, so twice this many spokes
+        static constexpr unsigned int BANDS = 16;
+        static constexpr unsigned int BINS_PER_BAND = 2;
+        // Radii are kept in quarter pixels
+        static constexpr unsigned int RADIUS_SCALE = 4;
+        static constexpr unsigned int FALL = 2;       // quarter pixels per update
+        // updates per step round the colour wheel, a full turn every ~12s
+        static constexpr unsigned int HUE_CYCLE_UPDATES = 4;
+
+        // off and the ring stay put, the rest of the palette is a hue wheel
+        // that's rotated under the spokes
+        static constexpr uint8_t INDEX_OFF = 0;
+        static constexpr uint8_t INDEX_RING = 1;
+        static constexpr unsigned int INDEX_HUES = 2;
+
+        // which band and how far out each pixel is, worked out once at init
+        uint8_t band_lut[Display::WIDTH * Display::HEIGHT];
+        uint8_t radius_lut[Display::WIDTH * Display::HEIGHT];
+        uint8_t max_radius;
+
+        uint8_t band_levels[BANDS];
+        uint8_t band_index[BANDS];
+        uint8_t ring_level;
+        unsigned int hue_phase;
+
+        IndexedFramebuffer<Display> framebuffer;
+
+        int max_sample_from_fft;
+        int lower_threshold;
+
+        uint8_t level_for(int sample);
+
+    public:
+        RadialFFT(Display& display, FIX_FFT &fft) : Effect(display, fft),
+            framebuffer(display) {}
+        void update(int16_t *buffer16, size_t sample_count) override;
+        void init(uint32_t sample_frequency) override;
+};
+
+class Particles : public Effect {
+    private:
+        // Hard cap on particles, this bounds the time taken by update()
+        static constexpr unsigned int MAX_PARTICLES = 128;
+        static constexpr unsigned int SPAWN_PER_ONSET = 16;
+        // Bins used to look for onsets, and to pick the colour of a burst
+        static constexpr unsigned int FLUX_FIRST_BIN = 1;
+        static constexpr unsigned int FLUX_BINS = 32;
+        static constexpr unsigned int ONSET_HOLDOFF = 6;  // buffers, about 70ms
+        static constexpr unsigned int HUES = 8;
+        static constexpr unsigned int SHADES = 4;
+        static constexpr uint8_t LIFE = 64;               // buffers, about 0.75s
+        static constexpr int16_t GRAVITY = 6;             // 1/256 pixels per buffer per buffer
+
+        ParticlePool<MAX_PARTICLES> pool;
+
+        int16_t previous_bins[FLUX_BINS];
+        int32_t average_flux;
+        unsigned int holdoff;
+        uint32_t random_state;
+
+        // a few shades of each hue, dimming as particles age
+        Palette<Display, HUES * SHADES> palette;
+
+        uint32_t random();
+        void burst(unsigned int hue, unsigned int count);
+
+    public:
+        Particles(Display& display, FIX_FFT &fft) : Effect(display, fft),
+            palette(display) {}
+        void update(int16_t *buffer16, size_t sample_count) override;
+        void init(uint32_t sample_frequency) override;
+};
+
+// Scrolls the title and artist of the current track across the middle of
+// the display a couple of times when they change.
+//
+// The text is rasterised once, when it changes, into a strip of 1bpp
+// columns so each update is just a blit of the visible part of the strip.
+class NowPlaying : public Overlay {
+    public:
+        static constexpr unsigned int MAX_TEXT = 64;          // per field
+        static constexpr unsigned int MAX_COLUMNS = 384;
+        static constexpr unsigned int PASSES = 2;
+        static constexpr unsigned int UPDATES_PER_COLUMN = 3; // about 29 columns a second
+
+    private:
+        // the text, and a shadow one pixel down and right to keep it
+        // readable over bright effects
+        static constexpr int BAND_HEIGHT = Font5x7::HEIGHT + 1;
+        static constexpr int BAND_Y = (Display::HEIGHT - BAND_HEIGHT) / 2;
+
+        Display &display;
+
+        struct Text {
+            char title[MAX_TEXT + 1];
+            char artist[MAX_TEXT + 1];
+        };
+
+        // The text crosses from the bluetooth side to draw() through three
+        // buffers. The writer fills the one it holds and swaps it for the
+        // middle one; draw() swaps its own for the middle one when there's
+        // something new there. Neither ever waits and draw() only ever sees
+        // a whole text.
+        static constexpr uint8_t TEXT_NEW = 4;
+        Text written = {};          // the bluetooth side's copy, to spot repeats
+        Text texts[3] = {};
+        uint8_t back = 0;           // the bluetooth side's buffer
+        uint8_t front = 1;          // draw()'s buffer
+        std::atomic<uint8_t> middle{2};
+
+        uint32_t columns[MAX_COLUMNS];
+        int column_count = 0;
+
+        int position = 0;
+        unsigned int passes = 0;
+        unsigned int ticks = 0;
+
+        // what was under the band before it was last drawn over
+        uint8_t saved[Display::WIDTH * BAND_HEIGHT * Display::BCD_FRAME_COUNT];
+        bool have_saved = false;
+
+        Palette<Display, 2> palette;
+
+        void set_field(char *field, const uint8_t *value, uint16_t length);
+        void append(const char *text);
+        void rasterise();
+
+    public:
+        NowPlaying(Display& display) : display(display),
+            palette(display) {
+            palette.set(0, 255, 255, 255);
+            palette.set(1, 0, 0, 0);
+        }
+
+        // safe to call while draw() runs on the other core, but only from
+        // one place at a time. The value needn't be terminated
+        void set_title(const uint8_t *value, uint16_t length) { set_field(written.title, value, length); }
+        void set_artist(const uint8_t *value, uint16_t length) { set_field(written.artist, value, length); }
+
+        void erase() override;
+        void draw() override;
+};
@@ -0,0 +1,10 @@
+add_library(effect_manager INTERFACE)
+
+target_sources(effect_manager INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}/effect_manager.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/lib/fixed_fft.cpp
+)
+
+target_include_directories(effect_manager INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}
+)
@@ -0,0 +1,126 @@
+#include "effect_manager.hpp"
+
+void EffectManager::select(unsigned int index) {
+    if (index < effects.size()) {
+        requested = index;
+    }
+}
+
+void EffectManager::step(int direction) {
+    int count = effects.size();
+    if (count == 0) return;
+    int index = ((int)requested + direction) % count;
+    select(index < 0 ? index + count : index);
+}
+
+void EffectManager::init(uint32_t sample_frequency) {
+    // scaled for bars of the display's height, the window is now filled
+    // with real samples throughout so this is half what it used to be
+    fft.set_scale(display.HEIGHT * .159f);
+
+    for(auto &effect : effects) {
+        effect->init(sample_frequency);
+    }
+
+    current = requested;
+    transitioning = false;
+
+    // the display is about to be cleared, don't put anything back over it
+    if (overlay) overlay->erase();
+}
+
+void EffectManager::analyse(int16_t *buffer16, bool transform) {
+    // slide the fft window along by one buffer
+    int16_t* fft_array = &fft.sample_array[SAMPLES_PER_AUDIO_BUFFER * (BUFFERS_PER_FFT_SAMPLE - 1)];
+    memmove(fft.sample_array, &fft.sample_array[SAMPLES_PER_AUDIO_BUFFER], SAMPLES_PER_AUDIO_BUFFER * (BUFFERS_PER_FFT_SAMPLE - 1) * sizeof(int16_t));
+
+    for (auto i = 0u; i < SAMPLES_PER_AUDIO_BUFFER; i++) {
+        fft_array[i] = buffer16[i];
+    }
+
+    if (transform) {
+        fft.update();
+    }
+}
+
+void EffectManager::run(unsigned int index, int16_t *buffer16, size_t sample_count) {
+    Effect *effect = effects[index];
+    Timing &timing = timings[index];
+
+    uint32_t start = time_us_32();
+    effect->update(buffer16, sample_count);
+    int32_t elapsed = time_us_32() - start;
+
+    timing.average_us += (elapsed - timing.average_us) / 8;
+
+    if (timing.hold) {
+        timing.hold--;
+        return;
+    }
+
+    unsigned int quality = effect->quality;
+    if (timing.average_us > (int32_t)budget_us && quality < Effect::QUALITY_LOWEST) {
+        quality++;
+    } else if (timing.average_us < (int32_t)budget_us / 2 && quality > Effect::QUALITY_FULL) {
+        quality--;
+    } else {
+        return;
+    }
+
+    printf("Effect %u: %ldus against %luus budget, quality %u\n", index, (long)timing.average_us, (unsigned long)budget_us, quality);
+    effect->set_quality(quality);
+    timing.hold = QUALITY_HOLD;
+}
+
+void EffectManager::update(int16_t *buffer16, size_t sample_count) {
+    if (effects.empty()) return;
+
+    buffer_count++;
+
+    if (overlay) overlay->erase();
+    draw_effects(buffer16, sample_count);
+    if (overlay) overlay->draw();
+}
+
+void EffectManager::draw_effects(int16_t *buffer16, size_t sample_count) {
+    unsigned int next = requested;
+    if (!transitioning && next != current) {
+        // pick up where the outgoing effect left off, the incoming one
+        // starts from black
+        display.read(from_buffer);
+        memset(to_buffer.pixels, 0, sizeof(to_buffer.pixels));
+
+        previous = current;
+        current = next;
+        transitioning = true;
+        transition_start = time_us_32();
+    }
+
+    if (!transitioning) {
+        // at the lowest quality only every other buffer is drawn, the
+        // window still has to move along but there's no need for the fft
+        bool skip = effects[current]->quality >= Effect::QUALITY_HALF_RATE && (buffer_count & 1);
+        analyse(buffer16, !skip);
+        if (!skip) {
+            run(current, buffer16, sample_count);
+        }
+        return;
+    }
+
+    analyse(buffer16, true);
+
+    display.capture(&from_buffer);
+    run(previous, buffer16, sample_count);
+    display.capture(&to_buffer);
+    run(current, buffer16, sample_count);
+    display.capture(nullptr);
+
+    uint32_t elapsed = time_us_32() - transition_start;
+    if (elapsed >= TRANSITION_US) {
+        // leave the incoming effect's image on the display to carry on from
+        display.blend(from_buffer, to_buffer, 256);
+        transitioning = false;
+    } else {
+        display.blend(from_buffer, to_buffer, (elapsed << 8) / TRANSITION_US);
+    }
+}
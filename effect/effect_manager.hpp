@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include "effect.hpp"
+
+// Owns the effects, runs the audio analysis they share and cross-fades
+// between them when a different one is selected.
+//
+// Each effect's update() is timed against a budget, a slice of the ~11.6ms
+// it takes to play a buffer, and its quality is stepped down when it runs
+// over so that refilling the audio doesn't suffer.
+class EffectManager {
+    public:
+        static constexpr unsigned int BUFFERS_PER_FFT_SAMPLE = 2;
+        static constexpr unsigned int SAMPLES_PER_AUDIO_BUFFER = SAMPLE_COUNT / BUFFERS_PER_FFT_SAMPLE;
+        static constexpr uint32_t TRANSITION_US = 500000;
+
+        static constexpr uint32_t DEFAULT_BUDGET_US = 5000;
+        // updates to wait after a quality change before judging it, about 0.5s
+        static constexpr uint32_t QUALITY_HOLD = 43;
+
+    private:
+        Display &display;
+        FIX_FFT &fft;
+
+        std::vector<Effect *> effects;
+        Overlay *overlay = nullptr;
+
+        struct Timing {
+            int32_t average_us = 0;
+            uint32_t hold = 0;
+        };
+        std::vector<Timing> timings;
+        uint32_t budget_us = DEFAULT_BUDGET_US;
+        uint32_t buffer_count = 0;
+        unsigned int current = 0;
+        unsigned int previous = 0;
+        volatile unsigned int requested = 0;
+
+        bool transitioning = false;
+        uint32_t transition_start = 0;
+
+        // both effects draw into these during a transition
+        Display::Framebuffer from_buffer;
+        Display::Framebuffer to_buffer;
+
+        void analyse(int16_t *buffer16, bool transform);
+        void run(unsigned int index, int16_t *buffer16, size_t sample_count);
+        void draw_effects(int16_t *buffer16, size_t sample_count);
+
+    public:
+        EffectManager(Display &display, FIX_FFT &fft) :
+            display(display),
+            fft(fft) {}
+
+        void add(Effect *effect) {
+            effects.push_back(effect);
+            timings.push_back(Timing());
+        }
+        // drawn over the effects, or nothing if null
+        void set_overlay(Overlay *value) { overlay = value; }
+
+        unsigned int count() const { return effects.size(); }
+        unsigned int get_current() const { return current; }
+
+        void set_budget_us(uint32_t budget) { budget_us = budget; }
+        uint32_t get_budget_us() const { return budget_us; }
+        int32_t get_average_us(unsigned int index) const { return timings[index].average_us; }
+
+        // safe to call from the other core, takes effect on the next update
+        void select(unsigned int index);
+        // step forwards or backwards through the effects, wrapping around
+        void step(int direction);
+
+        void init(uint32_t sample_frequency);
+        void update(int16_t *buffer16, size_t sample_count);
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "audio_levels.hpp"
+
+// Blocks of audio waiting to be shown, each stamped with the time it will
+// actually be heard so the effects can draw it then rather than as soon as
+// it's decoded.
+//
+// There's one producer (the audio refill) and one consumer (whatever runs
+// the effects), possibly on different cores. The producer only ever writes
+// the slot at the tail and the consumer only reads the one at the head, so
+// neither needs a lock. Nothing is allocated.
+template<unsigned int CAPACITY, unsigned int SAMPLES>
+class AnalysisQueue {
+    public:
+        struct Block {
+            uint32_t due_us;
+            AudioLevels levels;
+            int16_t samples[SAMPLES];
+        };
+
+    private:
+        Block blocks[CAPACITY];
+        std::atomic<uint32_t> head{0};
+        std::atomic<uint32_t> tail{0};
+
+    public:
+        static constexpr unsigned int capacity() { return CAPACITY; }
+
+        unsigned int size() const {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        // producer: the slot to fill next, or nullptr if the queue is full.
+        // It's only queued once push() is called
+        Block *back() {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) >= CAPACITY) return nullptr;
+            return &blocks[t % CAPACITY];
+        }
+        void push() {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // consumer: the oldest block, or nullptr if there isn't one. It
+        // stays put until pop() is called
+        Block *front() {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) return nullptr;
+            return &blocks[h % CAPACITY];
+        }
+        void pop() {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+// Per-channel levels of one buffer of interleaved stereo, gathered as the
+// audio driver applies the volume so it costs no extra pass over the
+// samples. Taken before the volume so the meter shows the source level.
+struct AudioLevels {
+    uint16_t peak[2] = {0, 0};          // largest magnitude seen
+    uint32_t sum_squares[2] = {0, 0};   // sum of (sample * sample) >> 8
+    uint32_t samples = 0;               // per channel
+
+    void reset() {
+        peak[0] = peak[1] = 0;
+        sum_squares[0] = sum_squares[1] = 0;
+        samples = 0;
+    }
+
+    // mean square, in full scale 16-bit units
+    uint32_t mean_square(unsigned int channel) const {
+        return samples ? (uint32_t)(((uint64_t)sum_squares[channel] << 8) / samples) : 0;
+    }
+};
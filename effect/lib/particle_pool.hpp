@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+
+// A fixed number of particles stored as separate arrays per field, so
+// updating one field for every particle walks memory in order. Live
+// particles are always packed at the front: spawning appends and killing
+// moves the last particle into the gap, both O(1). Nothing is allocated.
+//
+// Positions and velocities are 8.8 fixed point pixels.
+template<unsigned int CAPACITY>
+struct ParticlePool {
+    int16_t x[CAPACITY];
+    int16_t y[CAPACITY];
+    int16_t vx[CAPACITY];
+    int16_t vy[CAPACITY];
+    uint8_t life[CAPACITY];
+    uint8_t colour[CAPACITY];
+    unsigned int count = 0;
+
+    static constexpr unsigned int capacity() { return CAPACITY; }
+
+    bool full() const { return count == CAPACITY; }
+
+    // returns false, and does nothing, when the pool is full
+    bool spawn(int16_t px, int16_t py, int16_t pvx, int16_t pvy, uint8_t plife, uint8_t pcolour) {
+        if (count == CAPACITY) return false;
+        unsigned int i = count++;
+        x[i] = px;
+        y[i] = py;
+        vx[i] = pvx;
+        vy[i] = pvy;
+        life[i] = plife;
+        colour[i] = pcolour;
+        return true;
+    }
+
+    // the last particle takes this one's place, so don't advance past i
+    // when killing while iterating
+    void kill(unsigned int i) {
+        unsigned int last = --count;
+        x[i] = x[last];
+        y[i] = y[last];
+        vx[i] = vx[last];
+        vy[i] = vy[last];
+        life[i] = life[last];
+        colour[i] = colour[last];
+    }
+
+    void clear() { count = 0; }
+};
@@ -0,0 +1,9 @@
+add_library(now_playing INTERFACE)
+
+target_sources(now_playing INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}/now_playing.cpp
+)
+
+target_include_directories(now_playing INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}
+)
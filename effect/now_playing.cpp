@@ -0,0 +1,96 @@
+#include <string.h>
+#include "effect.hpp"
+
+void NowPlaying::set_field(char *field, const uint8_t *value, uint16_t length) {
+    // the font only has ascii, anything else in the utf-8 becomes a '?'
+    // per character
+    char text[MAX_TEXT + 1];
+    unsigned int count = 0;
+    for (auto i = 0u; i < length && value[i] && count < MAX_TEXT; i++) {
+        uint8_t c = value[i];
+        if (c >= 0x80 && c < 0xc0) continue;
+        text[count++] = (c >= Font5x7::FIRST && c <= Font5x7::LAST) ? c : '?';
+    }
+    text[count] = '\0';
+
+    // players repeat the track info, only start again for a new track
+    if (strcmp(field, text) == 0) return;
+    strcpy(field, text);
+
+    // hand over the whole of the new text, and take back whichever buffer
+    // draw() had finished with
+    texts[back] = written;
+    back = middle.exchange(back | TEXT_NEW, std::memory_order_acq_rel) & 3;
+}
+
+void NowPlaying::append(const char *text) {
+    for (; *text; text++) {
+        const uint8_t *glyph = Font5x7::glyph(*text);
+
+        // trim the empty columns either side so the text is proportional
+        int first = 0;
+        int last = Font5x7::WIDTH - 1;
+        while (first <= last && !glyph[first]) first++;
+        while (last >= first && !glyph[last]) last--;
+
+        if (first > last) {
+            first = 0;
+            last = 1;
+        }
+
+        for (int i = first; i <= last + 1 && column_count < (int)MAX_COLUMNS; i++) {
+            columns[column_count++] = i <= last ? glyph[i] : 0;
+        }
+    }
+}
+
+void NowPlaying::rasterise() {
+    const Text &text = texts[front];
+    column_count = 0;
+    append(text.title);
+    if (text.title[0] && text.artist[0]) append(" - ");
+    append(text.artist);
+
+    position = Display::WIDTH;
+    ticks = 0;
+    passes = column_count ? PASSES : 0;
+}
+
+void NowPlaying::erase() {
+    if (!have_saved) return;
+    display.restore_rows(BAND_Y, BAND_HEIGHT, saved);
+    have_saved = false;
+}
+
+void NowPlaying::draw() {
+    if (middle.load(std::memory_order_relaxed) & TEXT_NEW) {
+        front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+        rasterise();
+    }
+
+    if (passes == 0) return;
+
+    palette.refresh();
+
+    display.save_rows(BAND_Y, BAND_HEIGHT, saved);
+    have_saved = true;
+
+    // only hand over the columns that are on the display, the shadow needs
+    // one more on the left
+    int first = position < -1 ? -1 - position : 0;
+    int count = column_count - first;
+    if (count > Display::WIDTH + 1) count = Display::WIDTH + 1;
+
+    if (count > 0) {
+        display.blit(position + first + 1, BAND_Y + 1, &columns[first], count, Font5x7::HEIGHT, palette[1]);
+        display.blit(position + first, BAND_Y, &columns[first], count, Font5x7::HEIGHT, palette[0]);
+    }
+
+    if (++ticks < UPDATES_PER_COLUMN) return;
+    ticks = 0;
+
+    if (--position < -column_count) {
+        position = Display::WIDTH;
+        passes--;
+    }
+}
@@ -0,0 +1,9 @@
+add_library(particles INTERFACE)
+
+target_sources(particles INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}/particles.cpp
+)
+
+target_include_directories(particles INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}
+)
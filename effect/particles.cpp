@@ -0,0 +1,96 @@
+#include "lib/rgb.hpp"
+#include "effect.hpp"
+
+// Bursts of sparks on each onset in the music. Onsets are spotted by a
+// jump in spectral flux (the total rise across the low/mid bins) over its
+// recent average, and the loudest bin picks the colour of the burst.
+
+uint32_t Particles::random() {
+    // xorshift32, plenty for sparks
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+void Particles::burst(unsigned int hue, unsigned int count) {
+    int16_t x = (random() % display.WIDTH) << 8;
+    int16_t y = (random() % display.HEIGHT) << 8;
+
+    for (auto i = 0u; i < count; i++) {
+        int16_t vx = (int16_t)(random() % 129) - 64;
+        int16_t vy = (int16_t)(random() % 129) - 80;
+        uint8_t life = LIFE - (random() % (LIFE / 4));
+        if (!pool.spawn(x, y, vx, vy, life, hue)) {
+            break;
+        }
+    }
+}
+
+void Particles::update(int16_t *buffer16, size_t sample_count) {
+    palette.refresh();
+
+    // spectral flux over the low and mid bins
+    int32_t flux = 0;
+    int loudest = 0;
+    unsigned int loudest_bin = 0;
+    for (auto i = 0u; i < FLUX_BINS; i++) {
+        int bin = fix15_to_int(fft.get_scaled_as_fix15(i + FLUX_FIRST_BIN));
+        bin = std::min(bin, (int)INT16_MAX);
+        if (bin > previous_bins[i]) {
+            flux += bin - previous_bins[i];
+        }
+        if (bin > loudest) {
+            loudest = bin;
+            loudest_bin = i;
+        }
+        previous_bins[i] = bin;
+    }
+
+    if (holdoff) {
+        holdoff--;
+    } else if (flux > average_flux + average_flux / 2 && flux > FLUX_BINS * 16) {
+        burst(loudest_bin * HUES / FLUX_BINS, SPAWN_PER_ONSET);
+        holdoff = ONSET_HOLDOFF;
+    }
+    average_flux += (flux - average_flux) / 16;
+
+    // move everything along, dropping particles that have burnt out or
+    // left the display
+    for (auto i = 0u; i < pool.count; ) {
+        pool.vy[i] += GRAVITY;
+        pool.x[i] += pool.vx[i];
+        pool.y[i] += pool.vy[i];
+        pool.life[i]--;
+
+        if (pool.life[i] == 0 || pool.x[i] < 0 || pool.y[i] < 0
+            || (pool.x[i] >> 8) >= display.WIDTH || (pool.y[i] >> 8) >= display.HEIGHT) {
+            pool.kill(i);
+        } else {
+            i++;
+        }
+    }
+
+    display.clear();
+    for (auto i = 0u; i < pool.count; i++) {
+        unsigned int shade = pool.life[i] * SHADES / (LIFE + 1);
+        display.set_pixel(pool.x[i] >> 8, pool.y[i] >> 8, palette[pool.colour[i] * SHADES + shade]);
+    }
+}
+
+void Particles::init(uint32_t sample_frequency) {
+    printf("Particles: %ix%i, %u max\n", display.WIDTH, display.HEIGHT, MAX_PARTICLES);
+
+    pool.clear();
+    memset(previous_bins, 0, sizeof(previous_bins));
+    average_flux = 0;
+    holdoff = 0;
+    random_state = 0x9e3779b9;
+
+    for (auto hue = 0u; hue < HUES; hue++) {
+        for (auto shade = 0u; shade < SHADES; shade++) {
+            RGB c = RGB::from_hsv(float(hue) / HUES, 0.8f, float(shade + 1) / SHADES);
+            palette.set(hue * SHADES + shade, c.r, c.g, c.b);
+        }
+    }
+}
@@ -0,0 +1,9 @@
+add_library(radial_fft INTERFACE)
+
+target_sources(radial_fft INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}/radial_fft.cpp
+)
+
+target_include_directories(radial_fft INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}
+)
@@ -0,0 +1,105 @@
+#include "lib/rgb.hpp"
+#include "effect.hpp"
+
+// Spectrum spokes radiating from the centre of the display with a ring
+// that pulses with the bass. Every pixel's band and distance from the
+// centre are looked up, so there's no trig per frame. Pixels are drawn as
+// palette indices and the spokes' colours cycle by rotating the palette,
+// so the colours are never worked out per pixel.
+
+uint8_t RadialFFT::level_for(int sample) {
+    sample = std::min(max_sample_from_fft, sample) - lower_threshold;
+    if (sample <= 0) return 0;
+
+    // square root scale so quieter bands still show up
+    unsigned int squared = sample * max_radius * max_radius / (max_sample_from_fft - lower_threshold);
+    unsigned int level = 0;
+    while ((level + 1) * (level + 1) <= squared) {
+        level++;
+    }
+    return level;
+}
+
+void RadialFFT::update(int16_t *buffer16, size_t sample_count) {
+    for (auto band = 0u; band < BANDS; band++) {
+        int sample = 0;
+        for (auto bin = 0u; bin < BINS_PER_BAND; bin++) {
+            sample = std::max(sample, fix15_to_int(fft.get_scaled_as_fix15(band * BINS_PER_BAND + bin + FFT_SKIP_BINS)));
+        }
+
+        // jump up, fall back slowly
+        uint8_t level = level_for(sample);
+        band_levels[band] = std::max(level, (uint8_t)std::max(0, band_levels[band] - (int)FALL));
+    }
+
+    uint8_t ring = level_for(fix15_to_int(fft.get_scaled_as_fix15(FFT_SKIP_BINS)));
+    ring_level = std::max(ring, (uint8_t)std::max(0, ring_level - (int)FALL));
+
+    const uint8_t *band = band_lut;
+    const uint8_t *radius = radius_lut;
+    uint8_t *pixel = framebuffer.data();
+    int ring_inner = ring_level - RADIUS_SCALE / 2;
+    int ring_outer = ring_level + RADIUS_SCALE / 2;
+
+    for (auto i = 0; i < display.WIDTH * display.HEIGHT; i++) {
+        uint8_t b = *band++;
+        uint8_t r = *radius++;
+
+        if (ring_level > 0 && r >= ring_inner && r < ring_outer) {
+            *pixel++ = INDEX_RING;
+        } else if (r < band_levels[b]) {
+            *pixel++ = band_index[b];
+        } else {
+            *pixel++ = INDEX_OFF;
+        }
+    }
+
+    if (++hue_phase == HUE_CYCLE_UPDATES) {
+        hue_phase = 0;
+        framebuffer.rotate_palette(1);
+    }
+    framebuffer.update();
+}
+
+void RadialFFT::init(uint32_t sample_frequency) {
+    printf("RadialFFT: %ix%i\n", display.WIDTH, display.HEIGHT);
+
+    float cx = (display.WIDTH - 1) / 2.0f;
+    float cy = (display.HEIGHT - 1) / 2.0f;
+    max_radius = std::min(display.WIDTH, display.HEIGHT) * RADIUS_SCALE / 2;
+
+    for (auto y = 0; y < display.HEIGHT; y++) {
+        for (auto x = 0; x < display.WIDTH; x++) {
+            float dx = x - cx;
+            float dy = y - cy;
+
+            // angle away from straight up, either way round
+            float angle = fabsf(atan2f(dx, -dy)) / float(M_PI);
+            unsigned int band = std::min(BANDS - 1, (unsigned int)(angle * BANDS));
+            float radius = sqrtf(dx * dx + dy * dy) * RADIUS_SCALE;
+
+            band_lut[y * display.WIDTH + x] = band;
+            radius_lut[y * display.WIDTH + x] = std::min(255.0f, radius);
+        }
+    }
+
+    constexpr unsigned int hues = IndexedFramebuffer<Display>::PALETTE_SIZE - INDEX_HUES;
+    framebuffer.set_palette(INDEX_OFF, 0, 0, 0);
+    framebuffer.set_palette(INDEX_RING, 255, 255, 255);
+    for (auto i = 0u; i < hues; i++) {
+        RGB c = RGB::from_hsv(float(i) / hues, 1.0f, 0.8f);
+        framebuffer.set_palette(INDEX_HUES + i, c.r, c.g, c.b);
+    }
+    framebuffer.set_fixed(INDEX_HUES);
+    framebuffer.set_rotation(0);
+    hue_phase = 0;
+
+    for (auto band = 0u; band < BANDS; band++) {
+        band_index[band] = INDEX_HUES + band * hues / BANDS;
+        band_levels[band] = 0;
+    }
+    ring_level = 0;
+
+    max_sample_from_fft = 4000 + 130 * display.HEIGHT;
+    lower_threshold = 270 - 2 * display.HEIGHT;
+}
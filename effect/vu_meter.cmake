@@ -0,0 +1,9 @@
+add_library(vu_meter INTERFACE)
+
+target_sources(vu_meter INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}/vu_meter.cpp
+)
+
+target_include_directories(vu_meter INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}
+)
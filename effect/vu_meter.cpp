@@ -0,0 +1,78 @@
+#include "lib/rgb.hpp"
+#include "effect.hpp"
+
+// Left and right level meters across the width of the display, rms with
+// meter-like ballistics and a held peak marker. Levels are gathered by the
+// audio driver as it processes each buffer and queued with the block the
+// fft is run on, so both show the same audio.
+
+int VUMeter::db_to_x(float db) {
+    if (db <= DB_MIN) return 0;
+    if (db >= 0.0f) return display.WIDTH;
+    return (int)((db - DB_MIN) * display.WIDTH / -DB_MIN);
+}
+
+void VUMeter::update(int16_t *buffer16, size_t sample_count) {
+    palette_lit.refresh();
+    palette_unlit.refresh();
+    palette_peak.refresh();
+
+    // one channel per half of the display, with a row between them
+    const int bar_height = display.HEIGHT / 2;
+    const int bar_top[2] = {0, display.HEIGHT - bar_height};
+
+    for (auto channel = 0u; channel < 2; channel++) {
+        // rms, referenced so a full scale sine reads 0dB
+        uint32_t mean_square = levels.mean_square(channel);
+        float rms_db = mean_square ? 10.0f * log10f(float(mean_square) / (32768.0f * 32768.0f)) + 3.01f : DB_MIN;
+        float peak = levels.peak[channel] ? 20.0f * log10f(float(levels.peak[channel]) / 32768.0f) : DB_MIN;
+
+        float &level = level_db[channel];
+        level += (rms_db - level) * (rms_db > level ? ATTACK : RELEASE);
+
+        if (peak >= peak_db[channel]) {
+            peak_db[channel] = peak;
+            peak_hold[channel] = PEAK_HOLD;
+        } else if (peak_hold[channel]) {
+            peak_hold[channel]--;
+        } else {
+            peak_db[channel] = std::max(DB_MIN, peak_db[channel] - PEAK_FALL_DB);
+        }
+
+        int lit = db_to_x(level);
+        int peak_x = std::min(display.WIDTH - 1, db_to_x(peak_db[channel]));
+
+        int y0 = bar_top[channel];
+        int y1 = y0 + bar_height - 1;
+        for (auto x = 0; x < display.WIDTH; x++) {
+            display.draw_vline(x, y0, y1, x < lit ? palette_lit[x] : palette_unlit[x]);
+        }
+        if (peak_db[channel] > DB_MIN) {
+            display.draw_vline(peak_x, y0, y1, palette_peak[0]);
+        }
+    }
+
+    // the gap between the bars, if there is one
+    if (display.HEIGHT & 1) {
+        display.fill_rect(0, bar_height, display.WIDTH, 1, Display::BCDColour());
+    }
+}
+
+void VUMeter::init(uint32_t sample_frequency) {
+    printf("VUMeter: %ix%i\n", display.WIDTH, display.HEIGHT);
+
+    for (auto channel = 0u; channel < 2; channel++) {
+        level_db[channel] = DB_MIN;
+        peak_db[channel] = DB_MIN;
+        peak_hold[channel] = 0;
+    }
+
+    // green, then yellow from -12dB and red from -3dB
+    for (auto x = 0; x < display.WIDTH; x++) {
+        float db = DB_MIN + (x + 0.5f) * -DB_MIN / display.WIDTH;
+        RGB c = db < -12.0f ? RGB(0, 255, 0) : db < -3.0f ? RGB(255, 200, 0) : RGB(255, 0, 0);
+        palette_lit.set(x, c.r, c.g, c.b);
+        palette_unlit.set(x, c.r >> 4, c.g >> 4, c.b >> 4);
+    }
+    palette_peak.set(0, 255, 255, 255);
+}
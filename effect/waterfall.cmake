@@ -0,0 +1,10 @@
+add_library(waterfall INTERFACE)
+
+target_sources(waterfall INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}/waterfall.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/lib/fixed_fft.cpp
+)
+
+target_include_directories(waterfall INTERFACE
+  ${CMAKE_CURRENT_LIST_DIR}
+)
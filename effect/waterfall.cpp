@@ -0,0 +1,56 @@
+#include "lib/rgb.hpp"
+#include "effect.hpp"
+
+// A scrolling spectrogram. New rows are drawn across the top and the
+// history is pushed down the display with a hardware scroll, so only one
+// row of pixels is ever encoded per update.
+void Waterfall::update(int16_t *buffer16, size_t sample_count) {
+    palette.refresh();
+
+    // start a new row, the one that wraps around to the top is overwritten below
+    if (row_buffers == 0) {
+        display.scroll(1);
+        memset(row_levels, 0, sizeof(row_levels));
+    }
+
+    const int range = max_sample_from_fft - lower_threshold;
+
+    for (auto i = 0u; i < display.WIDTH; i++) {
+        int sample = std::min(max_sample_from_fft, fix15_to_int(fft.get_scaled_as_fix15(i + FFT_SKIP_BINS))) - lower_threshold;
+
+        // square root scale so quieter bins still show up
+        unsigned int level = 0;
+        if (sample > 0) {
+            unsigned int squared = sample * (LEVELS - 1) * (LEVELS - 1) / range;
+            while ((level + 1) * (level + 1) <= squared) {
+                level++;
+            }
+        }
+
+        // hold the loudest level seen while this row is on top
+        if (level > row_levels[i]) {
+            row_levels[i] = level;
+        }
+
+        display.set_pixel(i, 0, palette[row_levels[i]]);
+    }
+
+    row_buffers = (row_buffers + 1) % BUFFERS_PER_ROW;
+}
+
+void Waterfall::init(uint32_t sample_frequency) {
+    printf("Waterfall: %ix%i\n", display.WIDTH, display.HEIGHT);
+
+    row_buffers = 0;
+    memset(row_levels, 0, sizeof(row_levels));
+
+    // black through the colder colours up to red
+    for(auto i = 0u; i < LEVELS; i++) {
+        float t = float(i) / (LEVELS - 1);
+        RGB c = RGB::from_hsv(0.8f - 0.8f * t, 1.0f, t);
+        palette.set(i, c.r, c.g, c.b);
+    }
+
+    max_sample_from_fft = 4000 + 130 * display.HEIGHT;
+    lower_threshold = 270 - 2 * display.HEIGHT;
+}
@@ -0,0 +1,182 @@
+#include <math.h>
+#include <string.h>
+
+#include "bitstream_decoder.hpp"
+
+// pins, as wired on both boards
+static const uint32_t COLUMN_CLOCK = 13;
+static const uint32_t COLUMN_DATA  = 14;
+static const uint32_t COLUMN_LATCH = 15;
+static const uint32_t COLUMN_BLANK = 16;
+static const uint32_t ROW_BIT_0    = 17;
+
+static const PioEmulator::PinConfig UNICORN_PINS = {
+  ROW_BIT_0, 4,                  // out: row select
+  COLUMN_DATA, 3,                // set: data, latch, blank
+  COLUMN_CLOCK                   // side-set: clock
+};
+
+static const uint32_t UNICORN_INITIAL_PINS = 1u << COLUMN_BLANK | 0b1111u << ROW_BIT_0;
+
+// Galactic: 11 scan rows of 53 pixels, the first pixel shifted out is the
+// bottom right of the panel
+static bool galactic_locate(uint32_t row, uint32_t pixel, int &x, int &y) {
+  if(row >= 11 || pixel >= 53) return false;
+  x = 52 - pixel;
+  y = 10 - row;
+  return true;
+}
+
+// Cosmic: 16 scan rows of 64 pixels, the first 32 drive a row in the top
+// half of the panel and the last 32 the matching row in the bottom half
+static bool cosmic_locate(uint32_t row, uint32_t pixel, int &x, int &y) {
+  if(row >= 16 || pixel >= 64) return false;
+  if(pixel < 32) {
+    x = 31 - pixel;
+    y = 15 - row;
+  }else{
+    x = 63 - pixel;
+    y = 31 - row;
+  }
+  return true;
+}
+
+const PanelLayout &PanelLayout::galactic() {
+  static const PanelLayout layout = {
+    "galactic", "display/galactic/galactic_unicorn.pio", 53, 11, 53,
+    galactic_locate, UNICORN_PINS, UNICORN_INITIAL_PINS
+  };
+  return layout;
+}
+
+const PanelLayout &PanelLayout::cosmic() {
+  static const PanelLayout layout = {
+    "cosmic", "display/cosmic/cosmic_unicorn.pio", 32, 32, 64,
+    cosmic_locate, UNICORN_PINS, UNICORN_INITIAL_PINS
+  };
+  return layout;
+}
+
+const PanelLayout *PanelLayout::find(const std::string &name) {
+  if(name == "galactic") return &galactic();
+  if(name == "cosmic") return &cosmic();
+  return nullptr;
+}
+
+double DecodedFrame::linear(int x, int y, int channel) const {
+  uint64_t full = full_scale[y * width + x];
+  return full ? double(on(x, y, channel)) / full : 0.0;
+}
+
+double DecodedFrame::perceived(int x, int y, int channel, double gamma) const {
+  return pow(linear(x, y, channel), 1.0 / gamma) * 255.0;
+}
+
+class PanelModel : public PioListener {
+  private:
+    const PanelLayout &layout;
+    DecodedFrame &frame;
+
+    // one bit per driver output, in the order they were shifted in
+    std::vector<uint8_t> chain;
+    std::vector<uint8_t> latched;
+    size_t head = 0;
+
+    uint32_t pins;
+    uint32_t latched_row = 0;
+    uint64_t lit_run = 0;
+
+    uint32_t row_select() const {
+      return (pins >> ROW_BIT_0) & 0b1111;
+    }
+
+    // credit the time the current row has been lit to its leds
+    void flush() {
+      if(!lit_run) return;
+
+      for(uint32_t pixel = 0; pixel < layout.row_pixels; pixel++) {
+        int x, y;
+        if(!layout.locate(latched_row, pixel, x, y)) continue;
+
+        // each pixel is shifted out as blue, green then red
+        uint64_t *on = &frame.on_cycles[(y * frame.width + x) * 3];
+        if(latched[pixel * 3 + 2]) on[0] += lit_run;
+        if(latched[pixel * 3 + 1]) on[1] += lit_run;
+        if(latched[pixel * 3 + 0]) on[2] += lit_run;
+        frame.full_scale[y * frame.width + x] += lit_run;
+      }
+
+      lit_run = 0;
+    }
+
+  public:
+    PanelModel(const PanelLayout &layout, DecodedFrame &frame) :
+      layout(layout), frame(frame),
+      chain(layout.row_pixels * 3, 0), latched(layout.row_pixels * 3, 0),
+      pins(layout.initial_pins) {}
+
+    void step(uint32_t before, uint32_t after, uint32_t cycles) override {
+      // side-set clock edge, shifts in whatever is on the data pin
+      if(!(pins & (1u << COLUMN_CLOCK)) && (before & (1u << COLUMN_CLOCK))) {
+        chain[head] = (before >> COLUMN_DATA) & 1;
+        head = (head + 1) % chain.size();
+      }
+
+      bool was_blank = pins & (1u << COLUMN_BLANK);
+      bool blank = after & (1u << COLUMN_BLANK);
+      bool latch_rise = !(pins & (1u << COLUMN_LATCH)) && (after & (1u << COLUMN_LATCH));
+      bool row_change = ((pins ^ after) >> ROW_BIT_0) & 0b1111;
+
+      if(latch_rise || row_change || (blank && !was_blank)) {
+        flush();
+      }
+
+      pins = after;
+
+      if(latch_rise) {
+        // oldest bit in the chain is the first one shifted for this row
+        for(size_t i = 0; i < chain.size(); i++) {
+          latched[i] = chain[(head + i) % chain.size()];
+        }
+        frame.rows_scanned++;
+      }
+
+      latched_row = row_select();
+
+      if(!blank) {
+        lit_run += cycles;
+        frame.lit_cycles += cycles;
+      }
+    }
+
+    void finish() {
+      flush();
+    }
+};
+
+bool decode_bitstream(const PioProgram &program, const PanelLayout &layout,
+                      const uint8_t *bitstream, size_t length,
+                      DecodedFrame &frame, std::string &error) {
+  if(length % 4) {
+    error = "bitstream length is not a whole number of words";
+    return false;
+  }
+
+  frame.width = layout.width;
+  frame.height = layout.height;
+  frame.on_cycles.assign(layout.width * layout.height * 3, 0);
+  frame.full_scale.assign(layout.width * layout.height, 0);
+  frame.lit_cycles = 0;
+  frame.rows_scanned = 0;
+
+  // the dma hands the pio whole little endian words
+  std::vector<uint32_t> words(length / 4);
+  memcpy(words.data(), bitstream, length);
+
+  PanelModel panel(layout, frame);
+  PioEmulator pio(program, layout.pins, layout.initial_pins);
+  frame.frame_cycles = pio.run(words.data(), words.size(), panel);
+  panel.finish();
+
+  return true;
+}
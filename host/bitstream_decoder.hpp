@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "pio_emulator.hpp"
+
+// Turns a display bitstream back into the image a viewer would see by
+// running it through the board's PIO program and modelling the LED driver
+// chain: data is shifted in on rising clock edges, latched on the rising
+// edge of latch, and the latched outputs light the selected row for as long
+// as blank is low.
+//
+// This is written from the point of view of the hardware rather than the
+// encoder so it can be used to check the encoder.
+
+struct PanelLayout {
+  const char *name;
+  const char *program;           // pio program file, relative to the repo
+  int width;
+  int height;
+  uint32_t row_pixels;           // pixels shifted out per scan row
+
+  // where the given shifted pixel on a scan row ends up, false if nowhere
+  bool (*locate)(uint32_t row, uint32_t pixel, int &x, int &y);
+
+  PioEmulator::PinConfig pins;
+  uint32_t initial_pins;
+
+  static const PanelLayout &galactic();
+  static const PanelLayout &cosmic();
+  static const PanelLayout *find(const std::string &name);
+};
+
+struct DecodedFrame {
+  int width = 0;
+  int height = 0;
+
+  // cycles each led channel (r, g, b) was lit during one pass of the bitstream
+  std::vector<uint64_t> on_cycles;
+
+  // cycles a fully on led would have been lit for, per pixel
+  std::vector<uint64_t> full_scale;
+
+  uint64_t frame_cycles = 0;     // pio cycles for one pass of the bitstream
+  uint64_t lit_cycles = 0;       // cycles with any row enabled
+  uint32_t rows_scanned = 0;     // row/bcd frame latches seen
+
+  uint64_t on(int x, int y, int channel) const {
+    return on_cycles[(y * width + x) * 3 + channel];
+  }
+
+  // light output relative to a fully on led, 0.0-1.0
+  double linear(int x, int y, int channel) const;
+
+  // light output mapped back to a 0-255 value through the given gamma
+  double perceived(int x, int y, int channel, double gamma) const;
+
+  double refresh_hz(double pio_hz) const {
+    return frame_cycles ? pio_hz / frame_cycles : 0.0;
+  }
+
+  double duty_cycle() const {
+    return frame_cycles ? double(lit_cycles) / frame_cycles : 0.0;
+  }
+};
+
+bool decode_bitstream(const PioProgram &program, const PanelLayout &layout,
+                      const uint8_t *bitstream, size_t length,
+                      DecodedFrame &frame, std::string &error);
@@ -0,0 +1,87 @@
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "unicorn_display.hpp"
+#include "indexed_framebuffer.hpp"
+
+// Times the driver's drawing paths against in-memory displays laid out like
+// each of the real boards.
+
+template<typename Display>
+static double time_ns_per_pixel(Display &display, int frames, void (*draw)(Display &, int)) {
+  auto start = std::chrono::steady_clock::now();
+  for(int frame = 0; frame < frames; frame++) {
+    draw(display, frame);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  return ns / (double(frames) * Display::WIDTH * Display::HEIGHT);
+}
+
+template<typename Display>
+static void draw_gradient(Display &display, int frame) {
+  for(int y = 0; y < Display::HEIGHT; y++) {
+    for(int x = 0; x < Display::WIDTH; x++) {
+      display.set_pixel(x, y, x * 4 + frame, y * 8, frame);
+    }
+  }
+}
+
+template<typename Display>
+static void draw_clear(Display &display, int frame) {
+  display.clear();
+}
+
+template<typename Display>
+static void draw_fill(Display &display, int frame) {
+  display.fill_rect(0, 0, Display::WIDTH, Display::HEIGHT, frame, 128, 255 - frame);
+}
+
+template<typename Display>
+static void draw_bars(Display &display, int frame) {
+  typename Display::BCDColour colour = display.encode(frame, 128, 255 - frame);
+  for(int x = 0; x < Display::WIDTH; x++) {
+    display.draw_vline(x, 0, Display::HEIGHT - 1, colour);
+  }
+}
+
+template<typename Display>
+static void draw_indexed(Display &display, int frame) {
+  static IndexedFramebuffer<Display> framebuffer(display);
+  if(frame == 0) {
+    for(int i = 0; i < 256; i++) framebuffer.set_palette(i, i, 255 - i, i / 2);
+    for(int y = 0; y < Display::HEIGHT; y++) {
+      for(int x = 0; x < Display::WIDTH; x++) {
+        framebuffer.set_pixel(x, y, x * 4 + y * 8);
+      }
+    }
+  }
+
+  // a palette cycle, nothing is redrawn
+  framebuffer.rotate_palette(1);
+  framebuffer.update();
+}
+
+template<typename Display>
+static void bench(const char *name, int frames) {
+  static Display display;
+  display.init();
+
+  printf("%s (%ix%i, %u byte bitstream)\n", name, Display::WIDTH, Display::HEIGHT, (unsigned)Display::BITSTREAM_LENGTH);
+  printf("  set_pixel: %6.2f ns/pixel\n", time_ns_per_pixel<Display>(display, frames, draw_gradient<Display>));
+  printf("  clear:     %6.2f ns/pixel\n", time_ns_per_pixel<Display>(display, frames, draw_clear<Display>));
+  printf("  fill_rect: %6.2f ns/pixel\n", time_ns_per_pixel<Display>(display, frames, draw_fill<Display>));
+  printf("  vline:     %6.2f ns/pixel\n", time_ns_per_pixel<Display>(display, frames, draw_bars<Display>));
+  printf("  indexed:   %6.2f ns/pixel\n", time_ns_per_pixel<Display>(display, frames, draw_indexed<Display>));
+}
+
+int main(int argc, char *argv[]) {
+  int frames = argc > 1 ? atoi(argv[1]) : 2000;
+
+  bench<UnicornDisplay<VirtualGeometry<GalacticGeometry>>>("Galactic Unicorn", frames);
+  bench<UnicornDisplay<VirtualGeometry<CosmicGeometry>>>("Cosmic Unicorn", frames);
+
+  return 0;
+}
@@ -0,0 +1,286 @@
+#include <ctype.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "pio_emulator.hpp"
+
+static std::string trim(const std::string &s) {
+  size_t start = s.find_first_not_of(" \t\r");
+  if(start == std::string::npos) return "";
+  size_t end = s.find_last_not_of(" \t\r");
+  return s.substr(start, end - start + 1);
+}
+
+static bool parse_number(const std::string &s, uint32_t &value) {
+  if(s.empty()) return false;
+  char *end = nullptr;
+  if(s.size() > 2 && s[0] == '0' && (s[1] == 'b' || s[1] == 'B')) {
+    value = strtoul(s.c_str() + 2, &end, 2);
+  }else{
+    value = strtoul(s.c_str(), &end, 0);
+  }
+  return end && *end == '\0';
+}
+
+// split an instruction into words, treating commas as whitespace but
+// keeping [delay] together
+static std::vector<std::string> tokenise(const std::string &s) {
+  std::vector<std::string> tokens;
+  std::string current;
+  for(char c : s) {
+    if(c == ',' || isspace((unsigned char)c)) {
+      if(!current.empty()) tokens.push_back(current);
+      current.clear();
+    }else if(c == '[') {
+      if(!current.empty()) tokens.push_back(current);
+      current = "[";
+    }else{
+      current += c;
+    }
+  }
+  if(!current.empty()) tokens.push_back(current);
+  return tokens;
+}
+
+bool PioProgram::load(const std::string &path, std::string &error) {
+  std::ifstream file(path);
+  if(!file) {
+    error = "unable to open " + path;
+    return false;
+  }
+  std::stringstream source;
+  source << file.rdbuf();
+  return parse(source.str(), error);
+}
+
+bool PioProgram::parse(const std::string &source, std::string &error) {
+  struct Pending {
+    Instruction instruction;
+    std::vector<std::string> tokens;
+  };
+
+  std::vector<Pending> pending;
+  std::map<std::string, uint32_t> labels;
+  bool have_wrap_target = false;
+  bool have_wrap = false;
+
+  std::istringstream lines(source);
+  std::string line;
+  int line_number = 0;
+
+  while(std::getline(lines, line)) {
+    line_number++;
+
+    size_t comment = line.find(';');
+    if(comment != std::string::npos) line = line.substr(0, comment);
+    comment = line.find("//");
+    if(comment != std::string::npos) line = line.substr(0, comment);
+    line = trim(line);
+    if(line.empty()) continue;
+
+    if(line[0] == '.') {
+      std::vector<std::string> tokens = tokenise(line);
+      if(tokens[0] == ".program" && tokens.size() > 1) {
+        name = tokens[1];
+      }else if(tokens[0] == ".side_set" && tokens.size() > 1) {
+        parse_number(tokens[1], side_set_bits);
+      }else if(tokens[0] == ".wrap_target") {
+        wrap_target = pending.size();
+        have_wrap_target = true;
+      }else if(tokens[0] == ".wrap") {
+        wrap = pending.size() - 1;
+        have_wrap = true;
+      }
+      continue;
+    }
+
+    size_t colon = line.find(':');
+    if(colon != std::string::npos) {
+      labels[trim(line.substr(0, colon))] = pending.size();
+      line = trim(line.substr(colon + 1));
+      if(line.empty()) continue;
+    }
+
+    Pending p;
+    p.instruction.line = line_number;
+    p.tokens = tokenise(line);
+    pending.push_back(p);
+  }
+
+  if(!have_wrap_target) wrap_target = 0;
+  if(!have_wrap) wrap = pending.size() - 1;
+
+  for(auto &p : pending) {
+    Instruction &in = p.instruction;
+    std::vector<std::string> &t = p.tokens;
+    std::string where = "line " + std::to_string(in.line) + ": ";
+
+    // trailing side-set and delay
+    while(t.size() > 1) {
+      std::string &last = t.back();
+      if(last.front() == '[' && last.back() == ']') {
+        if(!parse_number(last.substr(1, last.size() - 2), in.delay)) {
+          error = where + "bad delay " + last;
+          return false;
+        }
+        t.pop_back();
+      }else if(t.size() > 2 && t[t.size() - 2] == "side") {
+        uint32_t side;
+        if(!parse_number(last, side)) {
+          error = where + "bad side-set " + last;
+          return false;
+        }
+        in.side = side;
+        t.pop_back();
+        t.pop_back();
+      }else{
+        break;
+      }
+    }
+
+    const std::string &op = t[0];
+    if(op == "nop") {
+      in.op = Op::NOP;
+    }else if(op == "out" || op == "set") {
+      in.op = op == "out" ? Op::OUT : Op::SET;
+      if(t.size() != 3) {
+        error = where + "expected " + op + " <dest>, <value>";
+        return false;
+      }
+      if(t[1] == "pins") in.dest = Dest::PINS;
+      else if(t[1] == "x") in.dest = Dest::X;
+      else if(t[1] == "y") in.dest = Dest::Y;
+      else if(t[1] == "null") in.dest = Dest::NULL_;
+      else if(t[1] == "pindirs") in.dest = Dest::PINDIRS;
+      else {
+        error = where + "unsupported destination " + t[1];
+        return false;
+      }
+      if(!parse_number(t[2], in.value)) {
+        error = where + "bad value " + t[2];
+        return false;
+      }
+    }else if(op == "jmp") {
+      in.op = Op::JMP;
+      std::string label;
+      if(t.size() == 2) {
+        label = t[1];
+      }else if(t.size() == 3) {
+        if(t[1] == "!x") in.cond = Cond::NOT_X;
+        else if(t[1] == "x--") in.cond = Cond::X_DEC;
+        else if(t[1] == "!y") in.cond = Cond::NOT_Y;
+        else if(t[1] == "y--") in.cond = Cond::Y_DEC;
+        else if(t[1] == "x!=y") in.cond = Cond::X_NE_Y;
+        else if(t[1] == "!osre") in.cond = Cond::NOT_OSRE;
+        else {
+          error = where + "unsupported condition " + t[1];
+          return false;
+        }
+        label = t[2];
+      }else{
+        error = where + "expected jmp [cond] <target>";
+        return false;
+      }
+      auto l = labels.find(label);
+      if(l != labels.end()) {
+        in.target = l->second;
+      }else if(!parse_number(label, in.target)) {
+        error = where + "unknown label " + label;
+        return false;
+      }
+    }else{
+      error = where + "unsupported instruction " + op;
+      return false;
+    }
+
+    instructions.push_back(in);
+  }
+
+  if(instructions.empty()) {
+    error = "no instructions";
+    return false;
+  }
+
+  return true;
+}
+
+void PioEmulator::write_pins(uint32_t base, uint32_t count, uint32_t value) {
+  uint32_t mask = ((1u << count) - 1) << base;
+  pins = (pins & ~mask) | ((value << base) & mask);
+}
+
+uint64_t PioEmulator::run(const uint32_t *data, size_t count, PioListener &listener) {
+  words = data;
+  word_count = count;
+  word_index = 0;
+  cycles = 0;
+
+  while(true) {
+    const PioProgram::Instruction &in = program.instructions[pc];
+
+    // autopull, the dma restarting from the top ends the pass
+    if(in.op == PioProgram::Op::OUT && osr_count >= 32) {
+      if(word_index >= word_count) break;
+      osr = words[word_index++];
+      osr_count = 0;
+    }
+
+    if(in.side >= 0) {
+      write_pins(config.sideset_base, program.side_set_bits, in.side);
+    }
+    uint32_t before = pins;
+    uint32_t next = pc == program.wrap ? program.wrap_target : pc + 1;
+
+    switch(in.op) {
+      case PioProgram::Op::NOP:
+        break;
+
+      case PioProgram::Op::OUT: {
+        uint32_t bits = in.value == 0 ? 32 : in.value;
+        uint32_t value = bits == 32 ? osr : osr & ((1u << bits) - 1);
+        osr = bits == 32 ? 0 : osr >> bits;
+        osr_count += bits;
+
+        switch(in.dest) {
+          case PioProgram::Dest::PINS: write_pins(config.out_base, config.out_count, value); break;
+          case PioProgram::Dest::X: x = value; break;
+          case PioProgram::Dest::Y: y = value; break;
+          default: break;
+        }
+        break;
+      }
+
+      case PioProgram::Op::SET:
+        switch(in.dest) {
+          case PioProgram::Dest::PINS: write_pins(config.set_base, config.set_count, in.value); break;
+          case PioProgram::Dest::X: x = in.value; break;
+          case PioProgram::Dest::Y: y = in.value; break;
+          default: break;
+        }
+        break;
+
+      case PioProgram::Op::JMP: {
+        bool taken = false;
+        switch(in.cond) {
+          case PioProgram::Cond::ALWAYS: taken = true; break;
+          case PioProgram::Cond::NOT_X: taken = x == 0; break;
+          case PioProgram::Cond::X_DEC: taken = x != 0; x--; break;
+          case PioProgram::Cond::NOT_Y: taken = y == 0; break;
+          case PioProgram::Cond::Y_DEC: taken = y != 0; y--; break;
+          case PioProgram::Cond::X_NE_Y: taken = x != y; break;
+          case PioProgram::Cond::NOT_OSRE: taken = osr_count < 32; break;
+        }
+        if(taken) next = in.target;
+        break;
+      }
+    }
+
+    uint32_t duration = 1 + in.delay;
+    listener.step(before, pins, duration);
+    cycles += duration;
+    pc = next;
+  }
+
+  return cycles;
+}
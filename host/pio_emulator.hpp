@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// A small host-side model of an RP2040 PIO state machine.
+//
+// It understands the subset of pioasm used by the display programs (out,
+// set, jmp, nop, side-set, delays and wrap) and runs a program against a
+// buffer of words the same way the DMA would feed it, with the OSR shifting
+// right and autopulling at 32 bits. Pin changes are reported to a listener
+// along with how many cycles each instruction took, which is all that's
+// needed to model what the LED drivers see.
+class PioProgram {
+  public:
+    enum class Op { JMP, OUT, SET, NOP };
+    enum class Dest { PINS, X, Y, NULL_, PINDIRS };
+    enum class Cond { ALWAYS, NOT_X, X_DEC, NOT_Y, Y_DEC, X_NE_Y, NOT_OSRE };
+
+    struct Instruction {
+      Op op;
+      Dest dest = Dest::NULL_;
+      Cond cond = Cond::ALWAYS;
+      uint32_t value = 0;         // bit count for out, value for set
+      uint32_t target = 0;        // jmp target
+      int32_t side = -1;          // side-set value, -1 if none
+      uint32_t delay = 0;
+      int line = 0;
+    };
+
+    std::string name;
+    std::vector<Instruction> instructions;
+    uint32_t side_set_bits = 0;
+    uint32_t wrap_target = 0;
+    uint32_t wrap = 0;
+
+    // parse a .pio source file, returns false and fills error on failure
+    bool load(const std::string &path, std::string &error);
+    bool parse(const std::string &source, std::string &error);
+};
+
+class PioListener {
+  public:
+    virtual ~PioListener() {}
+
+    // called once per executed instruction, before is the pin state going
+    // in (side-set already applied), after the state once it completes
+    virtual void step(uint32_t before, uint32_t after, uint32_t cycles) = 0;
+};
+
+class PioEmulator {
+  public:
+    struct PinConfig {
+      uint32_t out_base;
+      uint32_t out_count;
+      uint32_t set_base;
+      uint32_t set_count;
+      uint32_t sideset_base;
+    };
+
+  private:
+    const PioProgram &program;
+    PinConfig config;
+
+    uint32_t pc = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t osr = 0;
+    uint32_t osr_count = 32;
+    uint32_t pins = 0;
+
+    const uint32_t *words = nullptr;
+    size_t word_count = 0;
+    size_t word_index = 0;
+
+    uint64_t cycles = 0;
+
+    void write_pins(uint32_t base, uint32_t count, uint32_t value);
+
+  public:
+    PioEmulator(const PioProgram &program, PinConfig config, uint32_t initial_pins) :
+      program(program), config(config), pins(initial_pins) {}
+
+    // run until the data runs out at the top of the program, as it would
+    // when the dma is about to restart from the beginning of the bitstream
+    uint64_t run(const uint32_t *data, size_t count, PioListener &listener);
+
+    uint32_t get_pins() const { return pins; }
+};
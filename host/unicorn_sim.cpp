@@ -0,0 +1,200 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "unicorn_display.hpp"
+#include "bitstream_decoder.hpp"
+
+// Runs display bitstreams through the PIO program they're written for and
+// reports what would actually end up on the panel, how often it refreshes,
+// and how far the result is from what was drawn.
+
+struct Options {
+  std::string board = "galactic";
+  std::string pio;
+  std::string bitstream;
+  std::string ppm;
+  float brightness = 1.0f;
+  double sys_khz = 125000.0;
+  double gamma = 1.8;
+  int tolerance = 2;
+  int scroll = 0;
+};
+
+static void usage(const char *name) {
+  printf("usage: %s [galactic|cosmic] [options]\n", name);
+  printf("  --pio <file>          pio program to run (default: the board's program)\n");
+  printf("  --bitstream <file>    decode a raw bitstream dump instead of a test pattern\n");
+  printf("  --brightness <0-1>    display brightness for the test pattern (default 1.0)\n");
+  printf("  --sys-khz <khz>       pio clock (default 125000)\n");
+  printf("  --ppm <file>          write the perceived image\n");
+  printf("  --tolerance <n>       largest allowed error against the test pattern (default 2)\n");
+  printf("  --scroll <rows>       hardware scroll the test pattern after drawing it\n");
+}
+
+static uint8_t pattern(int x, int y, int channel, int width, int height) {
+  switch(channel) {
+    case 0: return x * 255 / (width - 1);
+    case 1: return y * 255 / (height - 1);
+    default: return ((x + y) & 1) ? 255 - (x * y) % 256 : 0;
+  }
+}
+
+template<typename Display>
+static std::vector<uint8_t> render_pattern(float brightness, int scroll) {
+  static Display display;
+  display.init();
+  display.set_brightness(brightness);
+
+  for(int y = 0; y < Display::HEIGHT; y++) {
+    for(int x = 0; x < Display::WIDTH; x++) {
+      display.set_pixel(x, y,
+        pattern(x, y, 0, Display::WIDTH, Display::HEIGHT),
+        pattern(x, y, 1, Display::WIDTH, Display::HEIGHT),
+        pattern(x, y, 2, Display::WIDTH, Display::HEIGHT));
+    }
+  }
+
+  display.scroll(scroll);
+
+  const uint8_t *bitstream = display.get_bitstream();
+  return std::vector<uint8_t>(bitstream, bitstream + Display::BITSTREAM_LENGTH);
+}
+
+static bool write_ppm(const std::string &path, const DecodedFrame &frame, double gamma) {
+  FILE *f = fopen(path.c_str(), "wb");
+  if(!f) return false;
+  fprintf(f, "P6\n%d %d\n255\n", frame.width, frame.height);
+  for(int y = 0; y < frame.height; y++) {
+    for(int x = 0; x < frame.width; x++) {
+      for(int c = 0; c < 3; c++) {
+        fputc((int)(frame.perceived(x, y, c, gamma) + 0.5), f);
+      }
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+
+  for(int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if(arg == "--help" || arg == "-h") {
+      usage(argv[0]);
+      return 0;
+    }else if(arg == "--pio" && has_value) {
+      options.pio = argv[++i];
+    }else if(arg == "--bitstream" && has_value) {
+      options.bitstream = argv[++i];
+    }else if(arg == "--brightness" && has_value) {
+      options.brightness = atof(argv[++i]);
+    }else if(arg == "--sys-khz" && has_value) {
+      options.sys_khz = atof(argv[++i]);
+    }else if(arg == "--ppm" && has_value) {
+      options.ppm = argv[++i];
+    }else if(arg == "--tolerance" && has_value) {
+      options.tolerance = atoi(argv[++i]);
+    }else if(arg == "--scroll" && has_value) {
+      options.scroll = atoi(argv[++i]);
+    }else if(arg[0] != '-') {
+      options.board = arg;
+    }else{
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  const PanelLayout *layout = PanelLayout::find(options.board);
+  if(!layout) {
+    fprintf(stderr, "unknown board %s\n", options.board.c_str());
+    return 1;
+  }
+
+  std::string error;
+  PioProgram program;
+  std::string pio_path = options.pio.empty() ? std::string(UNICORN_SOURCE_DIR "/") + layout->program : options.pio;
+  if(!program.load(pio_path, error)) {
+    fprintf(stderr, "%s: %s\n", pio_path.c_str(), error.c_str());
+    return 1;
+  }
+
+  std::vector<uint8_t> bitstream;
+  bool test_pattern = options.bitstream.empty();
+  if(test_pattern) {
+    if(layout == &PanelLayout::galactic()) {
+      bitstream = render_pattern<UnicornDisplay<VirtualGeometry<GalacticGeometry>>>(options.brightness, options.scroll);
+    }else{
+      bitstream = render_pattern<UnicornDisplay<VirtualGeometry<CosmicGeometry>>>(options.brightness, options.scroll);
+    }
+  }else{
+    std::ifstream file(options.bitstream, std::ios::binary);
+    if(!file) {
+      fprintf(stderr, "unable to open %s\n", options.bitstream.c_str());
+      return 1;
+    }
+    bitstream.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+  DecodedFrame frame;
+  if(!decode_bitstream(program, *layout, bitstream.data(), bitstream.size(), frame, error)) {
+    fprintf(stderr, "decode failed: %s\n", error.c_str());
+    return 1;
+  }
+
+  double pio_hz = options.sys_khz * 1000.0;
+  printf("%s: %s, %zu byte bitstream\n", layout->name, program.name.c_str(), bitstream.size());
+  printf("  rows latched:  %u\n", frame.rows_scanned);
+  printf("  frame:         %llu cycles, %.1f Hz at %.0f kHz\n", (unsigned long long)frame.frame_cycles, frame.refresh_hz(pio_hz), options.sys_khz);
+  printf("  duty cycle:    %.2f%% (rows enabled)\n", frame.duty_cycle() * 100.0);
+  if(frame.frame_cycles && !frame.full_scale.empty()) {
+    printf("  led duty:      %.2f%% (fully on led)\n", double(frame.full_scale[0]) / frame.frame_cycles * 100.0);
+  }
+
+  if(!options.ppm.empty() && !write_ppm(options.ppm, frame, options.gamma)) {
+    fprintf(stderr, "unable to write %s\n", options.ppm.c_str());
+    return 1;
+  }
+
+  if(!test_pattern) return 0;
+
+  // compare against what was drawn, after brightness scaling and with the
+  // rows wrapped around by any scroll
+  uint16_t brightness = floor(options.brightness * 256.0f);
+  int scroll = options.scroll % frame.height;
+  scroll = scroll < 0 ? scroll + frame.height : scroll;
+  double worst = 0.0;
+  double total = 0.0;
+  int worst_x = 0, worst_y = 0, worst_c = 0;
+  for(int y = 0; y < frame.height; y++) {
+    for(int x = 0; x < frame.width; x++) {
+      for(int c = 0; c < 3; c++) {
+        int drawn_y = (y - scroll + frame.height) % frame.height;
+        int expected = (pattern(x, drawn_y, c, frame.width, frame.height) * brightness) >> 8;
+        double error = fabs(frame.perceived(x, y, c, options.gamma) - expected);
+        total += error;
+        if(error > worst) {
+          worst = error;
+          worst_x = x; worst_y = y; worst_c = c;
+        }
+      }
+    }
+  }
+
+  printf("  pattern error: %.3f mean, %.3f max (at %d, %d %c)\n",
+    total / (frame.width * frame.height * 3), worst, worst_x, worst_y, "rgb"[worst_c]);
+
+  if(worst > options.tolerance) {
+    printf("FAIL: error exceeds tolerance of %d\n", options.tolerance);
+    return 1;
+  }
+
+  return 0;
+}
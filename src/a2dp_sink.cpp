@@ -85,7 +85,38 @@
 #include "btstack_sample_rate_compensation.h"
 #endif
 
-#include "btstack_ring_buffer.h"
+#include "latency_profile.hpp"
+#include "spsc_ring.hpp"
+#include "buttons.hpp"
+
+#ifdef DECODE_ON_CORE1
+#ifdef EFFECTS_ON_CORE1
+#error "DECODE_ON_CORE1 and EFFECTS_ON_CORE1 both want core1, pick one"
+#endif
+#include "pico/flash.h"
+#include "pico/multicore.h"
+#endif
+
+#ifdef USE_FREERTOS
+#ifdef DECODE_ON_CORE1
+#error "the FreeRTOS build always decodes in its own task, leave DECODE_ON_CORE1 off"
+#endif
+#include "freertos_tasks.hpp"
+#endif
+
+// sbc decoding runs apart from the audio output, either on core1 or in
+// its own task
+#if defined(DECODE_ON_CORE1) || defined(USE_FREERTOS)
+#define DECODE_PIPELINED
+#endif
+
+// now playing overlay, in btstack_audio_pico.cpp
+void btstack_audio_pico_set_now_playing_title(const uint8_t * value, uint16_t length);
+void btstack_audio_pico_set_now_playing_artist(const uint8_t * value, uint16_t length);
+
+// speaker eq, in btstack_audio_pico.cpp
+void btstack_audio_pico_set_eq_enabled(bool enabled);
+bool btstack_audio_pico_get_eq_enabled(void);
 
 #define NUM_CHANNELS 2
 #define BYTES_PER_FRAME     (2*NUM_CHANNELS)
@@ -115,28 +146,49 @@ static btstack_sbc_decoder_state_t state;
 static btstack_sbc_mode_t mode = SBC_MODE_STANDARD;
 
 // ring buffer for SBC Frames
-// below 30: add samples, 30-40: fine, above 40: drop samples
-#define OPTIMAL_FRAMES_MIN 60
-#define OPTIMAL_FRAMES_MAX 80
+// below the latency profile's sbc_frames_min: add samples, up to its
+// sbc_frames_max: fine, above that: drop samples
 #define ADDITIONAL_FRAMES  30
-static uint8_t sbc_frame_storage[(OPTIMAL_FRAMES_MAX + ADDITIONAL_FRAMES) * MAX_SBC_FRAME_SIZE];
-static btstack_ring_buffer_t sbc_frame_ring_buffer;
+static SpscRing<(LATENCY_MAX_SBC_FRAMES + ADDITIONAL_FRAMES) * MAX_SBC_FRAME_SIZE> sbc_frame_ring_buffer;
 static unsigned int sbc_frame_size;
 
-// overflow buffer for not fully used sbc frames, with additional frames for resampling
-static uint8_t decoded_audio_storage[(128+16) * BYTES_PER_FRAME];
-static btstack_ring_buffer_t decoded_audio_ring_buffer;
+// smoothed sbc frames buffered, in 1/16ths, and the rate to turn that into
+// time, for reporting the latency
+static int sbc_frames_average_q4;
+static uint32_t media_sampling_frequency;
+
+// decoded and resampled audio waiting to be played: up to a whole audio
+// buffer, plus room for the most one sbc frame can resample to
+#define MAX_DECODED_FRAMES (128+16)
+static SpscRing<(LATENCY_MAX_BUFFER_FRAMES + MAX_DECODED_FRAMES) * BYTES_PER_FRAME> decoded_audio_ring_buffer;
+static unsigned int decoded_audio_underruns;
+
+#ifdef DECODE_PIPELINED
+// The decoder (on core1 or in the decode task) owns the sbc decoder and
+// resampler while it's running and keeps the decoded ring topped up from
+// the sbc ring; the audio output only copies decoded audio out. Each
+// change to decode_request (bit 0 set while running) is acknowledged in
+// decode_ack once the decoder has finished with it.
+static std::atomic<uint32_t> decode_request;
+static std::atomic<uint32_t> decode_ack;
+#endif
+#ifdef DECODE_ON_CORE1
+constexpr int core1_stack_len = 1024;
+static uint32_t core1_stack[core1_stack_len];
+static void decode_core1_entry(void);
+#endif
+#ifdef USE_FREERTOS
+static TaskHandle_t decode_task_handle;
+static void decode_task(void * params);
+#endif
 
 static int media_initialized = 0;
 static int audio_stream_started;
 static btstack_resample_t resample_instance;
 
-// temp storage of lower-layer request for audio samples
-static int16_t * request_buffer;
-static int       request_frames;
-
-// sink state
-static int volume_percentage = 0;
+// sink state, the audio driver starts each stream at full volume
+static int volume_percentage = 100;
+static constexpr int BUTTON_VOLUME_STEP = 5;
 static avrcp_battery_status_t battery_status = AVRCP_BATTERY_STATUS_WARNING;
 
 typedef struct {
@@ -215,6 +267,14 @@ static void stdin_process(char cmd);
 
 static int a2dp_and_avrcp_setup(void){
 
+#ifdef DECODE_ON_CORE1
+    multicore_launch_core1_with_stack(decode_core1_entry, core1_stack, sizeof(core1_stack));
+#endif
+#ifdef USE_FREERTOS
+    xTaskCreate(decode_task, "decode", DECODE_TASK_STACK_SIZE, NULL, DECODE_TASK_PRIORITY, &decode_task_handle);
+    vTaskCoreAffinitySet(decode_task_handle, DECODE_TASK_CORES);
+#endif
+
     l2cap_init();
 
 #ifdef ENABLE_BLE
@@ -315,6 +375,72 @@ static int a2dp_and_avrcp_setup(void){
 btstack_sample_rate_compensation_t sample_rate_compensation;
 #endif
 
+// decode one sbc frame into the decoded ring, if there's one waiting and
+// room for it
+static bool decode_sbc_frame(void){
+    unsigned int frame_size = sbc_frame_size;
+    if (frame_size == 0) return false;
+    if (decoded_audio_ring_buffer.bytes_free() < MAX_DECODED_FRAMES * BYTES_PER_FRAME) return false;
+    if (sbc_frame_ring_buffer.bytes_available() < frame_size) return false;
+
+    uint8_t sbc_frame[MAX_SBC_FRAME_SIZE];
+    sbc_frame_ring_buffer.read(sbc_frame, frame_size);
+    btstack_sbc_decoder_process_data(&state, 0, sbc_frame, frame_size);
+    return true;
+}
+
+#ifdef DECODE_PIPELINED
+// let the decoder know there may be something for it to do
+static void decode_wake(void){
+#ifdef USE_FREERTOS
+    xTaskNotifyGive(decode_task_handle);
+#endif
+}
+#endif
+
+#ifdef DECODE_ON_CORE1
+static void decode_core1_entry(void){
+    // btstack keeps its link keys in flash, core1 has to be parked while
+    // they're written
+    flash_safe_execute_core_init();
+    while (true){
+        uint32_t request = decode_request.load(std::memory_order_acquire);
+        if (!(request & 1) || !decode_sbc_frame()){
+            tight_loop_contents();
+        }
+        decode_ack.store(request, std::memory_order_release);
+    }
+}
+#endif
+
+#ifdef USE_FREERTOS
+static void decode_task(void * params){
+    UNUSED(params);
+    while (true){
+        uint32_t request = decode_request.load(std::memory_order_acquire);
+        bool decoded = (request & 1) && decode_sbc_frame();
+        decode_ack.store(request, std::memory_order_release);
+        if (!decoded){
+            // until there's a new frame, room for one or a new request
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    }
+}
+#endif
+
+#ifdef DECODE_PIPELINED
+// hand the decoder over or take it back, either way only returning once
+// the decoder has seen it
+static void decode_set_running(bool running){
+    uint32_t request = (((decode_request.load(std::memory_order_relaxed) >> 1) + 1) << 1) | (running ? 1 : 0);
+    decode_request.store(request, std::memory_order_release);
+    decode_wake();
+    while (decode_ack.load(std::memory_order_acquire) != request){
+        tight_loop_contents();
+    }
+}
+#endif
+
 static void playback_handler(int16_t * buffer, uint16_t num_audio_frames){
     
     // called from lower-layer but guaranteed to be on main thread
@@ -323,20 +449,18 @@ static void playback_handler(int16_t * buffer, uint16_t num_audio_frames){
         return;
     }
 
-    // first fill from resampled audio
-    uint32_t bytes_read;
-    btstack_ring_buffer_read(&decoded_audio_ring_buffer, (uint8_t *) buffer, num_audio_frames * BYTES_PER_FRAME, &bytes_read);
-    buffer          += bytes_read / NUM_CHANNELS;
-    num_audio_frames   -= bytes_read / BYTES_PER_FRAME;
-
-    // then start decoding sbc frames using request_* globals
-    request_buffer = buffer;
-    request_frames = num_audio_frames;
-    while (request_frames && btstack_ring_buffer_bytes_available(&sbc_frame_ring_buffer) >= sbc_frame_size){
-        // decode frame
-        uint8_t sbc_frame[MAX_SBC_FRAME_SIZE];
-        btstack_ring_buffer_read(&sbc_frame_ring_buffer, sbc_frame, sbc_frame_size, &bytes_read);
-        btstack_sbc_decoder_process_data(&state, 0, sbc_frame, sbc_frame_size);
+    unsigned int bytes = num_audio_frames * BYTES_PER_FRAME;
+#ifndef DECODE_PIPELINED
+    // decode until there's enough for the request
+    while (decoded_audio_ring_buffer.bytes_available() < bytes && decode_sbc_frame());
+#endif
+    unsigned int bytes_read = decoded_audio_ring_buffer.read(buffer, bytes);
+#ifdef DECODE_PIPELINED
+    decode_wake();
+#endif
+    if (bytes_read < bytes){
+        memset((uint8_t *)buffer + bytes_read, 0, bytes - bytes_read);
+        decoded_audio_underruns++;
     }
 }
 
@@ -350,24 +474,12 @@ static void handle_pcm_data(int16_t * data, int num_audio_frames, int num_channe
         return;
     }
 
-    // resample into request buffer - add some additional space for resampling
-    int16_t  output_buffer[(128+16) * NUM_CHANNELS]; // 16 * 8 * 2
+    // resample - add some additional space for resampling
+    int16_t  output_buffer[MAX_DECODED_FRAMES * NUM_CHANNELS]; // 16 * 8 * 2
     uint32_t resampled_frames = btstack_resample_block(&resample_instance, data, num_audio_frames, output_buffer);
 
-    // store data in btstack_audio buffer first
-    int frames_to_copy = btstack_min(resampled_frames, request_frames);
-    memcpy(request_buffer, output_buffer, frames_to_copy * BYTES_PER_FRAME);
-    request_frames  -= frames_to_copy;
-    request_buffer  += frames_to_copy * NUM_CHANNELS;
-
-    // and rest in ring buffer
-    int frames_to_store = resampled_frames - frames_to_copy;
-    if (frames_to_store){
-        int status = btstack_ring_buffer_write(&decoded_audio_ring_buffer, (uint8_t *)&output_buffer[frames_to_copy * NUM_CHANNELS], frames_to_store * BYTES_PER_FRAME);
-        if (status){
-            printf("Error storing samples in PCM ring buffer!!!\n");
-        }
-    }
+    // decode_sbc_frame() made sure there's room
+    decoded_audio_ring_buffer.write(output_buffer, resampled_frames * BYTES_PER_FRAME);
 }
 
 static int media_processing_init(media_codec_configuration_sbc_t * configuration){
@@ -376,9 +488,10 @@ static int media_processing_init(media_codec_configuration_sbc_t * configuration
     btstack_sample_rate_compensation_init( &sample_rate_compensation, btstack_run_loop_get_time_ms(), configuration->sampling_frequency, FLOAT_TO_Q15(1.f) );
 #endif
     btstack_sbc_decoder_init(&state, mode, handle_pcm_data, NULL);
+    media_sampling_frequency = configuration->sampling_frequency;
 
-    btstack_ring_buffer_init(&sbc_frame_ring_buffer, sbc_frame_storage, sizeof(sbc_frame_storage));
-    btstack_ring_buffer_init(&decoded_audio_ring_buffer, decoded_audio_storage, sizeof(decoded_audio_storage));
+    sbc_frame_ring_buffer.reset();
+    decoded_audio_ring_buffer.reset();
     btstack_resample_init(&resample_instance, configuration->num_channels);
 
     // setup audio playback
@@ -396,6 +509,16 @@ static void media_processing_start(void){
     if (!media_initialized) return;
 #ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
     btstack_sample_rate_compensation_reset( &sample_rate_compensation, btstack_run_loop_get_time_ms() );
+#endif
+    decoded_audio_underruns = 0;
+#ifdef DECODE_PIPELINED
+    // let the decoder get a buffer ahead before the output starts asking
+    decode_set_running(true);
+    const LatencyProfile * profile = btstack_audio_pico_get_latency_profile();
+    while (decoded_audio_ring_buffer.bytes_available() < profile->buffer_frames * BYTES_PER_FRAME
+        && sbc_frame_ring_buffer.bytes_available() >= sbc_frame_size){
+        tight_loop_contents();
+    }
 #endif
     // setup audio playback
     const btstack_audio_sink_t * audio = btstack_audio_sink_get_instance();
@@ -407,21 +530,30 @@ static void media_processing_start(void){
 
 static void media_processing_pause(void){
     if (!media_initialized) return;
+    // each sbc frame is 128 samples
+    printf("SBC: %d frames buffered, %lums, %u underruns\n", sbc_frames_average_q4 >> 4,
+        (unsigned long)((sbc_frames_average_q4 >> 4) * 128u * 1000u / media_sampling_frequency), decoded_audio_underruns);
     // stop audio playback
     audio_stream_started = 0;
     const btstack_audio_sink_t * audio = btstack_audio_sink_get_instance();
     if (audio){
         audio->stop_stream();
     }
+#ifdef DECODE_PIPELINED
+    decode_set_running(false);
+#endif
     // discard pending data
-    btstack_ring_buffer_reset(&decoded_audio_ring_buffer);
-    btstack_ring_buffer_reset(&sbc_frame_ring_buffer);
+    decoded_audio_ring_buffer.reset();
+    sbc_frame_ring_buffer.reset();
 }
 
 static void media_processing_close(void){
     if (!media_initialized) return;
     media_initialized = 0;
     audio_stream_started = 0;
+#ifdef DECODE_PIPELINED
+    decode_set_running(false);
+#endif
     sbc_frame_size = 0;
 
     // stop audio playback
@@ -464,19 +596,23 @@ static void handle_l2cap_media_data_packet(uint8_t seid, uint8_t *packet, uint16
     // store sbc frame size for buffer management
     sbc_frame_size = (size-pos)/ sbc_header.num_frames;
         
-    int status = btstack_ring_buffer_write(&sbc_frame_ring_buffer, packet+pos, size-pos);
-    if (status != ERROR_CODE_SUCCESS){
+    if (!sbc_frame_ring_buffer.write(packet+pos, size-pos)){
         printf("Error storing samples in SBC ring buffer!!!\n");
     }
+#ifdef DECODE_PIPELINED
+    decode_wake();
+#endif
 
     // decide on audio sync drift based on number of sbc frames in queue
-    int sbc_frames_in_buffer = btstack_ring_buffer_bytes_available(&sbc_frame_ring_buffer) / sbc_frame_size;
+    int sbc_frames_in_buffer = sbc_frame_ring_buffer.bytes_available() / sbc_frame_size;
+    sbc_frames_average_q4 += ((sbc_frames_in_buffer << 4) - sbc_frames_average_q4) / 16;
+    const LatencyProfile * profile = btstack_audio_pico_get_latency_profile();
 #ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
     // update sample rate compensation
     if( audio_stream_started && (audio != NULL)) {
         uint32_t resampling_factor = btstack_sample_rate_compensation_update( &sample_rate_compensation, btstack_run_loop_get_time_ms(), sbc_header.num_frames*128, audio->get_samplerate() );
         btstack_resample_set_factor(&resample_instance, resampling_factor);
-//        printf("sbc buffer level :            %d\n", btstack_ring_buffer_bytes_available(&sbc_frame_ring_buffer));
+//        printf("sbc buffer level :            %d\n", sbc_frame_ring_buffer.bytes_available());
     }
 #else
     uint32_t resampling_factor;
@@ -485,18 +621,20 @@ static void handle_l2cap_media_data_packet(uint8_t seid, uint8_t *packet, uint16
     uint32_t nominal_factor = 0x10000;
     uint32_t compensation   = 0x00100;
 
-    if (sbc_frames_in_buffer < OPTIMAL_FRAMES_MIN){
+    if (sbc_frames_in_buffer < profile->sbc_frames_min){
     	resampling_factor = nominal_factor - compensation;    // stretch samples
-    } else if (sbc_frames_in_buffer <= OPTIMAL_FRAMES_MAX){
+    } else if (sbc_frames_in_buffer <= profile->sbc_frames_max){
     	resampling_factor = nominal_factor;                   // nothing to do
     } else {
     	resampling_factor = nominal_factor + compensation;    // compress samples
     }
 
+    // only stores the factor, so it's safe with core1 decoding: the
+    // resampler picks it up from its next block
     btstack_resample_set_factor(&resample_instance, resampling_factor);
 #endif
     // start stream if enough frames buffered
-    if (!audio_stream_started && sbc_frames_in_buffer >= OPTIMAL_FRAMES_MIN){
+    if (!audio_stream_started && sbc_frames_in_buffer >= profile->sbc_frames_min){
         media_processing_start();
     }
 }
@@ -642,6 +780,8 @@ static void avrcp_controller_packet_handler(uint8_t packet_type, uint16_t channe
             return;
         case AVRCP_SUBEVENT_NOTIFICATION_TRACK_CHANGED:
             printf("AVRCP Controller: Track changed\n");
+            // fetch the title and artist for the now playing overlay
+            avrcp_controller_get_now_playing_info(avrcp_connection->avrcp_cid);
             return;
         case AVRCP_SUBEVENT_NOTIFICATION_AVAILABLE_PLAYERS_CHANGED:
             printf("AVRCP Controller: Changed\n");
@@ -664,6 +804,7 @@ static void avrcp_controller_packet_handler(uint8_t packet_type, uint16_t channe
             if (avrcp_subevent_now_playing_title_info_get_value_len(packet) > 0){
                 memcpy(avrcp_subevent_value, avrcp_subevent_now_playing_title_info_get_value(packet), avrcp_subevent_now_playing_title_info_get_value_len(packet));
                 printf("AVRCP Controller:     Title: %s\n", avrcp_subevent_value);
+                btstack_audio_pico_set_now_playing_title(avrcp_subevent_now_playing_title_info_get_value(packet), avrcp_subevent_now_playing_title_info_get_value_len(packet));
             }  
             break;
 
@@ -671,6 +812,7 @@ static void avrcp_controller_packet_handler(uint8_t packet_type, uint16_t channe
             if (avrcp_subevent_now_playing_artist_info_get_value_len(packet) > 0){
                 memcpy(avrcp_subevent_value, avrcp_subevent_now_playing_artist_info_get_value(packet), avrcp_subevent_now_playing_artist_info_get_value_len(packet));
                 printf("AVRCP Controller:     Artist: %s\n", avrcp_subevent_value);
+                btstack_audio_pico_set_now_playing_artist(avrcp_subevent_now_playing_artist_info_get_value(packet), avrcp_subevent_now_playing_artist_info_get_value_len(packet));
             }  
             break;
         
@@ -929,11 +1071,17 @@ static void show_usage(void){
     printf("t - volume up   for 10 percent\n");
     printf("T - volume down for 10 percent\n");
     printf("V - toggle Battery status from AVRCP_BATTERY_STATUS_NORMAL to AVRCP_BATTERY_STATUS_FULL_CHARGE\n");
+
+    printf("\n--- Audio ---\n");
+    printf("y - next latency profile (low latency, balanced, robust), from the next stream\n");
+    printf("e - toggle the speaker eq\n");
     printf("---\n");
 }
 #endif
 
 #ifdef HAVE_BTSTACK_STDIN
+static unsigned int latency_profile = LATENCY_PROFILE;
+
 static void stdin_process(char cmd){
     uint8_t status = ERROR_CODE_SUCCESS;
     uint8_t volume;
@@ -965,6 +1113,13 @@ static void stdin_process(char cmd){
         case '\n':
         case '\r':
             break;
+        case 'y':
+            latency_profile = (latency_profile + 1) % LATENCY_PROFILE_COUNT;
+            btstack_audio_pico_set_latency_profile(latency_profile);
+            break;
+        case 'e':
+            btstack_audio_pico_set_eq_enabled(!btstack_audio_pico_get_eq_enabled());
+            break;
         case 'w':
             printf("Send delay report\n");
             avdtp_sink_delay_report(a2dp_connection->a2dp_cid, a2dp_connection->a2dp_local_seid, 100);
@@ -1105,6 +1260,56 @@ static void stdin_process(char cmd){
 }
 #endif
 
+// The volume buttons step the volume and tell the source, a click on C
+// plays or pauses and holding it toggles the speaker eq, a click on D
+// skips forward and holding it skips back
+static void a2dp_sink_button_handler(unsigned int button, button_event_t event){
+    a2dp_sink_demo_avrcp_connection_t * avrcp_connection = &a2dp_sink_demo_avrcp_connection;
+    uint8_t status = ERROR_CODE_SUCCESS;
+    uint8_t volume;
+
+    switch (button){
+        case BUTTON_VOLUME_UP:
+        case BUTTON_VOLUME_DOWN:
+            if (event != BUTTON_PRESSED && event != BUTTON_REPEATED) return;
+            if (button == BUTTON_VOLUME_UP){
+                volume_percentage = volume_percentage <= 100 - BUTTON_VOLUME_STEP ? volume_percentage + BUTTON_VOLUME_STEP : 100;
+            } else {
+                volume_percentage = volume_percentage >= BUTTON_VOLUME_STEP ? volume_percentage - BUTTON_VOLUME_STEP : 0;
+            }
+            volume = volume_percentage * 127 / 100;
+            printf("Volume: %d%% (%d)\n", volume_percentage, volume);
+            avrcp_volume_changed(volume);
+            if (avrcp_connection->avrcp_cid != 0){
+                status = avrcp_target_volume_changed(avrcp_connection->avrcp_cid, volume);
+            }
+            break;
+        case BUTTON_C:
+            if (event == BUTTON_CLICKED){
+                if (avrcp_connection->playing){
+                    status = avrcp_controller_pause(avrcp_connection->avrcp_cid);
+                } else {
+                    status = avrcp_controller_play(avrcp_connection->avrcp_cid);
+                }
+            } else if (event == BUTTON_HELD){
+                btstack_audio_pico_set_eq_enabled(!btstack_audio_pico_get_eq_enabled());
+            }
+            break;
+        case BUTTON_D:
+            if (event == BUTTON_CLICKED){
+                status = avrcp_controller_forward(avrcp_connection->avrcp_cid);
+            } else if (event == BUTTON_HELD){
+                status = avrcp_controller_backward(avrcp_connection->avrcp_cid);
+            }
+            break;
+        default:
+            break;
+    }
+    if (status != ERROR_CODE_SUCCESS){
+        printf("Button: could not perform command, status 0x%02x\n", status);
+    }
+}
+
 int btstack_main(int argc, const char * argv[]);
 int btstack_main(int argc, const char * argv[]){
     UNUSED(argc);
@@ -1112,6 +1317,9 @@ int btstack_main(int argc, const char * argv[]){
 
     a2dp_and_avrcp_setup();
 
+    buttons_init();
+    buttons_add_handler(a2dp_sink_button_handler);
+
 #ifdef HAVE_BTSTACK_STDIN
     // parse human-readable Bluetooth address
     sscanf_bd_addr(device_addr_string, device_addr);
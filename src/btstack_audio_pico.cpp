@@ -50,8 +50,13 @@
 #include "btstack_audio.h"
 #include "btstack_run_loop.h"
 
+#include <atomic>
+#include <math.h>
 #include <stddef.h>
+#include <hardware/clocks.h>
 #include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
 
 #include "pico/audio_i2s.h"
 #include "pico/stdlib.h"
@@ -59,34 +64,75 @@
 #include "pico/sync.h"
 
 #include "display.hpp"
+#include "auto_brightness.hpp"
 #include "effect.hpp"
+#include "effect_manager.hpp"
 #include "lib/fixed_fft.hpp"
+#include "lib/audio_levels.hpp"
+#include "lib/analysis_queue.hpp"
+#include "latency_profile.hpp"
+#include "equaliser.hpp"
+#include "clock_governor.hpp"
+#include "buttons.hpp"
+
+#ifdef USE_FREERTOS
+#ifdef EFFECTS_ON_CORE1
+#error "the FreeRTOS build always draws the effects in their own task, leave EFFECTS_ON_CORE1 off"
+#endif
+#include "freertos_tasks.hpp"
+#endif
+
+// the effects are drawn from a loop of their own (on core1, or in the
+// render task) rather than from a timer on the run loop
+#if defined(EFFECTS_ON_CORE1) || defined(USE_FREERTOS)
+#define EFFECTS_OWN_LOOP
+#endif
 
-#define DRIVER_POLL_INTERVAL_MS 5
 
 Display display;
+AutoBrightness auto_brightness(display);
 FIX_FFT fft;
+AudioLevels audio_levels;
 RainbowFFT rainbow_fft(display, fft);
 ClassicFFT classic_fft(display, fft);
+Waterfall waterfall(display, fft);
+VUMeter vu_meter(display, fft, audio_levels);
+RadialFFT radial_fft(display, fft);
+Particles particles(display, fft);
+NowPlaying now_playing(display);
 
-std::vector<Effect *> effects;
-unsigned int current_effect = 0;
+EffectManager effects(display, fft);
 
 #ifdef EFFECTS_ON_CORE1
+// in words, the effect manager keeps row and swap buffers on the stack
 constexpr int core1_stack_len = 512;
-uint32_t core1_stack[512];
-int16_t effect_buf[SAMPLE_COUNT] = {0};
+static uint32_t core1_stack[core1_stack_len];
 #endif
 
 static constexpr unsigned int BUFFERS_PER_FFT_SAMPLE = 2;
 static constexpr unsigned int SAMPLES_PER_AUDIO_BUFFER = SAMPLE_COUNT / BUFFERS_PER_FFT_SAMPLE;
 
+// the frames audio_i2s_connect() holds in its own two 256 frame buffers:
+// on average half of one still to play and all of the other
+static constexpr unsigned int I2S_QUEUED_FRAMES = 256 / 2 + 256;
+
+// effects work on whole blocks of SAMPLE_COUNT, built up from one or more
+// audio buffers
+static_assert(SAMPLES_PER_AUDIO_BUFFER == LATENCY_MAX_BUFFER_FRAMES, "audio buffers are sized for the effects");
+static_assert(LATENCY_PROFILES[LATENCY_PROFILE_LOW].buffer_frames * 2 == SAMPLES_PER_AUDIO_BUFFER, "buffers must divide an effect block");
+
+// audio waiting to be shown when it's heard, enough for everything that
+// can be queued ahead of it with some to spare
+typedef AnalysisQueue<6, SAMPLE_COUNT> EffectQueue;
+EffectQueue effect_queue;
+
 
 // client
 static void (*playback_callback)(int16_t * buffer, uint16_t num_samples);
 
-// timer to fill output ring buffer
-static btstack_timer_source_t  driver_timer_sink;
+// refills the producer pool on the run loop, polled from the i2s dma
+// interrupt whenever it finishes with a buffer
+static btstack_data_source_t   driver_data_source_sink;
 
 static bool btstack_audio_pico_sink_active;
 
@@ -97,21 +143,279 @@ static audio_buffer_format_t btstack_audio_pico_producer_format;
 static audio_buffer_pool_t * btstack_audio_pico_audio_buffer_pool;
 static uint8_t               btstack_audio_pico_channel_count;
 static uint8_t               btstack_volume;
+
+// Volume. Each avrcp absolute volume (0-127) gets a gain on a dB scale,
+// from VOLUME_RANGE_DB down at 1 to unity at 127, with 0 silent. Gains are
+// Q15 and ramp across a buffer when the volume changes rather than step.
+static constexpr float       VOLUME_RANGE_DB = 60.0f;
+static constexpr int32_t     UNITY_GAIN = 1 << 15;
+static uint16_t              btstack_audio_pico_gain_lut[128];
+static int32_t               btstack_audio_pico_gain;
+// buffers filled in a row at zero gain, the amplifier is muted once
+// everything queued is silent
+static unsigned int          btstack_audio_pico_silent_buffers;
+static bool                  btstack_audio_pico_muted;
+
+// Silence. A source that's connected but not playing anything still sends
+// audio, so once every sample has been below SILENCE_LEVEL for
+// SILENCE_HOLD_MS the effects stop being fed (and with them the fft), the
+// display stops scanning out and the amplifier is muted, until the first
+// buffer with something in it. SILENCE_LEVEL is a power of two so one
+// OR of the magnitudes over a buffer is enough to tell. 16 is about -66dB,
+// well under anything audible but over the noise lossy decoding leaves
+#ifndef SILENCE_HOLD_MS
+#define SILENCE_HOLD_MS 10000
+#endif
+static constexpr uint32_t    SILENCE_LEVEL = 16;
+static_assert((SILENCE_LEVEL & (SILENCE_LEVEL - 1)) == 0, "the silence level must be a power of two");
+static uint32_t              btstack_audio_pico_silent_frames;
+static uint32_t              btstack_audio_pico_silence_hold_frames;
+static bool                  btstack_audio_pico_silenced;
+
+// Speaker eq, after the volume. These tame the small speaker on the back of
+// the boards: nothing useful comes out below about 120Hz so it isn't
+// driven there, with a little lift above that and some presence taken out
+#ifndef SPEAKER_EQ
+#define SPEAKER_EQ 1
+#endif
+static const Equaliser::Band btstack_audio_pico_eq_bands[] = {
+    {Equaliser::Type::HIGH_PASS,   120.0f, 0.707f,  0.0f},
+    {Equaliser::Type::LOW_SHELF,   300.0f, 0.707f,  4.0f},
+    {Equaliser::Type::PEAK,       2500.0f, 1.0f,   -3.0f},
+    {Equaliser::Type::HIGH_SHELF, 8000.0f, 0.707f,  3.0f},
+};
+static Equaliser             btstack_audio_pico_equaliser;
+static bool                  btstack_audio_pico_eq_enabled = SPEAKER_EQ;
+// time spent in the eq this stream, to report the headroom left
+static uint32_t              btstack_audio_pico_eq_us;
+static uint32_t              btstack_audio_pico_eq_buffers;
 static uint8_t               btstack_last_sample_idx;
+static uint32_t              btstack_audio_pico_latency_us;
+
+// the pool is created for the largest profile, buffers a smaller one
+// doesn't use are parked here while a stream runs
+static audio_buffer_t *      btstack_audio_pico_parked[LATENCY_MAX_BUFFER_COUNT];
+static unsigned int          btstack_audio_pico_parked_count;
+static const LatencyProfile * btstack_audio_pico_profile = &LATENCY_PROFILES[LATENCY_PROFILE];
+static const LatencyProfile * btstack_audio_pico_requested_profile = &LATENCY_PROFILES[LATENCY_PROFILE];
+
+// samples so far in the effect block being built
+static unsigned int          btstack_audio_pico_effect_fill;
+
+// switched off from the sleep button, as well as whenever it's silenced
+static bool                  btstack_audio_pico_display_off;
+static constexpr float       BRIGHTNESS_STEP = 1.0f / 16.0f;
+
+// init_audio runs again each time a stream is restarted, the i2s, pool and
+// display are only set up the first time
+static bool                  btstack_audio_pico_initialized;
+
+// the i2s state machine, for the clock governor
+static constexpr unsigned int btstack_audio_pico_i2s_sm = 0;
+
+// Cycles the effects take to draw a block, smoothed, written wherever they
+// run. The clock is raised while they'd take more than BOOST_PERCENT of a
+// block's time at the streaming clock, and let down again once they'd take
+// less than RELAX_PERCENT
+static volatile uint32_t     btstack_audio_pico_render_cycles;
+static constexpr uint32_t    RENDER_BOOST_PERCENT = 60;
+static constexpr uint32_t    RENDER_RELAX_PERCENT = 40;
+
+#ifdef EFFECTS_OWN_LOOP
+// The effects' own loop owns the effects, what's on the display and the
+// reading end of effect_queue. Each stream starting or stopping changes
+// effects_request (bit 0 set while a stream runs), and the loop acknowledges
+// it in effects_ack once it has finished drawing and started over.
+static std::atomic<uint32_t> btstack_audio_pico_effects_request;
+static std::atomic<uint32_t> btstack_audio_pico_effects_ack;
+#endif
+#ifdef USE_FREERTOS
+// notified for each request, so it's taken up without waiting for a tick
+static TaskHandle_t          btstack_audio_pico_render_task_handle;
+#endif
+
+// draw the oldest queued block if its audio is being heard by now, returns
+// false if there's nothing due
+static bool btstack_audio_pico_run_effects(void){
+    EffectQueue::Block * block = effect_queue.front();
+    if (block == NULL || (int32_t)(block->due_us - time_us_32()) > 0){
+        return false;
+    }
 
-auto_init_mutex(core1_effect_update);
+    audio_levels = block->levels;
+    uint32_t start = time_us_32();
+    effects.update(block->samples, SAMPLE_COUNT);
+    uint32_t cycles = (uint64_t)(time_us_32() - start) * clock_get_hz(clk_sys) / 1000000u;
+    uint32_t average = btstack_audio_pico_render_cycles;
+    btstack_audio_pico_render_cycles = average + (int32_t)(cycles - average) / 8;
+    effect_queue.pop();
+    return true;
+}
+
+// A stream starting or stopping. Nothing queued from the last stream is
+// shown, the effects start over for a new one and the display is cleared.
+// Only called from wherever the effects are drawn
+static void btstack_audio_pico_restart_effects(bool running){
+    while (effect_queue.front() != NULL){
+        effect_queue.pop();
+    }
+    if (running){
+        effects.init(btstack_audio_pico_audio_format.sample_freq);
+    }
+    display.clear();
+}
+
+#ifdef EFFECTS_OWN_LOOP
+// one pass of the effects' own loop: take up any start or stop, then draw
+// the next block if one's due. Returns false if there was nothing to do
+static bool btstack_audio_pico_effects_loop(void){
+    uint32_t request = btstack_audio_pico_effects_request.load(std::memory_order_acquire);
+    if (request != btstack_audio_pico_effects_ack.load(std::memory_order_relaxed)){
+        btstack_audio_pico_restart_effects(request & 1);
+        btstack_audio_pico_effects_ack.store(request, std::memory_order_release);
+    }
+    return (request & 1) && btstack_audio_pico_run_effects();
+}
+
+// hand a stream starting or stopping to the effects' loop, only returning
+// once it has finished with the last block and started over
+static void btstack_audio_pico_effects_set_running(bool running){
+    uint32_t request = (((btstack_audio_pico_effects_request.load(std::memory_order_relaxed) >> 1) + 1) << 1) | (running ? 1 : 0);
+    btstack_audio_pico_effects_request.store(request, std::memory_order_release);
+#ifdef USE_FREERTOS
+    xTaskNotifyGive(btstack_audio_pico_render_task_handle);
+#endif
+    while (btstack_audio_pico_effects_ack.load(std::memory_order_acquire) != request){
+        tight_loop_contents();
+    }
+}
+#endif
 
 #ifdef EFFECTS_ON_CORE1
 void core1_entry() {
     while(1) {
-        mutex_enter_blocking(&core1_effect_update);
-        effects[0]->update(effect_buf, SAMPLE_COUNT);
-        mutex_exit(&core1_effect_update);
+        if (!btstack_audio_pico_effects_loop()){
+            tight_loop_contents();
+        }
+    }
+}
+#elif defined(USE_FREERTOS)
+static void render_task(void * params) {
+    (void) params;
+    while(1) {
+        // blocks are tens of ms apart, a tick late is never noticed. A
+        // start or stop wakes it straight away
+        if (!btstack_audio_pico_effects_loop()){
+            ulTaskNotifyTake(pdTRUE, 1);
+        }
     }
 }
+#else
+// timer for the next queued block, on the run loop with the audio
+static btstack_timer_source_t effect_timer;
+static bool                   effect_timer_active;
+
+static void effect_timer_handler(btstack_timer_source_t * ts);
+
+static void btstack_audio_pico_schedule_effects(void){
+    if (effect_timer_active) return;
+
+    EffectQueue::Block * block = effect_queue.front();
+    if (block == NULL) return;
+
+    int32_t wait_us = block->due_us - time_us_32();
+    btstack_run_loop_set_timer_handler(&effect_timer, &effect_timer_handler);
+    btstack_run_loop_set_timer(&effect_timer, wait_us > 0 ? (wait_us + 999) / 1000 : 0);
+    btstack_run_loop_add_timer(&effect_timer);
+    effect_timer_active = true;
+}
+
+static void effect_timer_handler(btstack_timer_source_t * ts){
+    (void) ts;
+    effect_timer_active = false;
+    while (btstack_audio_pico_run_effects());
+    btstack_audio_pico_schedule_effects();
+}
 #endif
 
-static audio_buffer_pool_t *init_audio(uint32_t sample_frequency, uint8_t channel_count) {
+static void btstack_audio_pico_init_gain_lut(void){
+    btstack_audio_pico_gain_lut[0] = 0;
+    for (auto volume = 1u; volume < 128; volume++){
+        float db = ((float)volume - 127.0f) * VOLUME_RANGE_DB / 126.0f;
+        btstack_audio_pico_gain_lut[volume] = (uint16_t)(powf(10.0f, db / 20.0f) * UNITY_GAIN + 0.5f);
+    }
+}
+
+// the MUTE pin enables the amplifier when high
+static void btstack_audio_pico_set_muted(bool muted){
+    if (muted == btstack_audio_pico_muted) return;
+    gpio_put(Display::MUTE, !muted);
+    btstack_audio_pico_muted = muted;
+}
+
+static void btstack_audio_pico_set_silenced(bool silenced){
+    if (silenced == btstack_audio_pico_silenced) return;
+    btstack_audio_pico_silenced = silenced;
+    display.set_sleeping(silenced || btstack_audio_pico_display_off);
+}
+
+// A and B step back and forth through the effects. The brightness buttons
+// take over from the light sensor until sleep is held, and a click on
+// sleep switches the display off until the next one
+static void btstack_audio_pico_button_handler(unsigned int button, button_event_t event){
+    switch (button){
+        case BUTTON_A:
+        case BUTTON_B:
+            if (event == BUTTON_PRESSED){
+                effects.step(button == BUTTON_A ? -1 : 1);
+            }
+            break;
+        case BUTTON_BRIGHTNESS_UP:
+        case BUTTON_BRIGHTNESS_DOWN:
+            if (event == BUTTON_PRESSED || event == BUTTON_REPEATED){
+                auto_brightness.set_enabled(false);
+                display.adjust_brightness(button == BUTTON_BRIGHTNESS_UP ? BRIGHTNESS_STEP : -BRIGHTNESS_STEP);
+            }
+            break;
+        case BUTTON_SLEEP:
+            if (event == BUTTON_CLICKED){
+                btstack_audio_pico_display_off = !btstack_audio_pico_display_off;
+                display.set_sleeping(btstack_audio_pico_silenced || btstack_audio_pico_display_off);
+            } else if (event == BUTTON_HELD){
+                auto_brightness.set_enabled(true);
+                printf("Display: brightness follows the light sensor\n");
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// How long until the first sample of a buffer given to the pool now is
+// heard: the producer buffers queued ahead of it, less the part of the
+// oldest one the i2s has already taken (half on average), plus the i2s
+// driver's own buffers. Called while holding the buffer, so it isn't free
+// or queued
+static uint32_t btstack_audio_pico_output_latency_us(void){
+    audio_buffer_pool_t * pool = btstack_audio_pico_audio_buffer_pool;
+
+    unsigned int free_count = 0;
+    uint32_t save = spin_lock_blocking(pool->free_list_spin_lock);
+    for (audio_buffer_t * buffer = pool->free_list; buffer != NULL; buffer = buffer->next){
+        free_count++;
+    }
+    spin_unlock(pool->free_list_spin_lock, save);
+
+    unsigned int buffer_frames = btstack_audio_pico_profile->buffer_frames;
+    unsigned int queued = LATENCY_MAX_BUFFER_COUNT - btstack_audio_pico_parked_count - 1 - free_count;
+    uint32_t frames = queued * buffer_frames + I2S_QUEUED_FRAMES;
+    if (queued > 0){
+        frames -= buffer_frames / 2;
+    }
+    return (uint64_t)frames * 1000000u / btstack_audio_pico_audio_format.sample_freq;
+}
+
+static void init_audio(uint32_t sample_frequency, uint8_t channel_count) {
 
     // num channels requested by application
     btstack_audio_pico_channel_count = channel_count;
@@ -128,40 +432,109 @@ static audio_buffer_pool_t *init_audio(uint32_t sample_frequency, uint8_t channe
 
     btstack_volume = 127;
 
-    audio_buffer_pool_t * producer_pool = audio_new_producer_pool(&btstack_audio_pico_producer_format, 3, SAMPLES_PER_AUDIO_BUFFER); // todo correct size
+    if (!btstack_audio_pico_initialized){
+        // the i2s follows changes to the sample rate in the format, so none
+        // of this needs doing again, or can be: the pio and dma are claimed
+        btstack_audio_pico_init_gain_lut();
 
-    audio_i2s_config_t config;
-    config.data_pin       = PICO_AUDIO_I2S_DATA_PIN;
-    config.clock_pin_base = PICO_AUDIO_I2S_CLOCK_PIN_BASE;
-    config.dma_channel    = (int8_t) dma_claim_unused_channel(true);
-    config.pio_sm         = 0;
+        btstack_audio_pico_audio_buffer_pool = audio_new_producer_pool(&btstack_audio_pico_producer_format, LATENCY_MAX_BUFFER_COUNT, LATENCY_MAX_BUFFER_FRAMES);
 
-    // audio_i2s_setup claims the channel again https://github.com/raspberrypi/pico-extras/issues/48
-    dma_channel_unclaim(config.dma_channel);
-    const audio_format_t * output_format = audio_i2s_setup(&btstack_audio_pico_audio_format, &config);
-    if (!output_format) {
-        panic("PicoAudio: Unable to open audio device.\n");
-    }
+        audio_i2s_config_t config;
+        config.data_pin       = PICO_AUDIO_I2S_DATA_PIN;
+        config.clock_pin_base = PICO_AUDIO_I2S_CLOCK_PIN_BASE;
+        config.dma_channel    = (int8_t) dma_claim_unused_channel(true);
+        config.pio_sm         = btstack_audio_pico_i2s_sm;
 
-    bool ok = audio_i2s_connect(producer_pool);
-    assert(ok);
-    (void)ok;
+        // audio_i2s_setup claims the channel again https://github.com/raspberrypi/pico-extras/issues/48
+        dma_channel_unclaim(config.dma_channel);
+        const audio_format_t * output_format = audio_i2s_setup(&btstack_audio_pico_audio_format, &config);
+        if (!output_format) {
+            panic("PicoAudio: Unable to open audio device.\n");
+        }
 
-    effects.push_back(&rainbow_fft);
-    effects.push_back(&classic_fft);
+        bool ok = audio_i2s_connect(btstack_audio_pico_audio_buffer_pool);
+        assert(ok);
+        (void)ok;
 
-    for(auto &effect : effects) {
-        effect->init(sample_frequency);
-    }
+        effects.add(&rainbow_fft);
+        effects.add(&classic_fft);
+        effects.add(&waterfall);
+        effects.add(&vu_meter);
+        effects.add(&radial_fft);
+        effects.add(&particles);
+        effects.set_overlay(&now_playing);
 
-    display.init();
-    display.clear();
+        display.init();
+        auto_brightness.init();
+        buttons_add_handler(btstack_audio_pico_button_handler);
 
 #ifdef EFFECTS_ON_CORE1
-    multicore_launch_core1_with_stack(core1_entry, core1_stack, core1_stack_len);
+        multicore_launch_core1_with_stack(core1_entry, core1_stack, sizeof(core1_stack));
+#endif
+#ifdef USE_FREERTOS
+        xTaskCreate(render_task, "render", RENDER_TASK_STACK_SIZE, NULL, RENDER_TASK_PRIORITY, &btstack_audio_pico_render_task_handle);
+        vTaskCoreAffinitySet(btstack_audio_pico_render_task_handle, RENDER_TASK_CORES);
 #endif
+        btstack_audio_pico_initialized = true;
+    }
+
+    btstack_audio_pico_equaliser.configure(btstack_audio_pico_eq_bands, count_of(btstack_audio_pico_eq_bands), sample_frequency);
 
-    return producer_pool;
+    clock_governor_set_i2s(pio_get_instance(PICO_AUDIO_I2S_PIO), btstack_audio_pico_i2s_sm, sample_frequency);
+
+    btstack_audio_pico_silence_hold_frames = (uint64_t)sample_frequency * SILENCE_HOLD_MS / 1000u;
+}
+
+// The one pass over each buffer on its way to the i2s. For every frame it
+// takes a copy of the incoming audio for the effects (if there's room for
+// one), gathers its levels, applies the ramping gain and, for a mono
+// source, spreads the sample across both channels. Frames are loaded and
+// stored as one word holding both samples. Returns every magnitude ORed
+// together, for the silence check.
+//
+// Mono input is packed into the first half of the buffer so it's walked
+// backwards, each stereo word only overwrites samples already used.
+template<bool MONO>
+static uint32_t btstack_audio_pico_process_buffer(uint32_t * words, unsigned int frames, int32_t gain_q23, int32_t gain_step, int16_t * tap, AudioLevels & levels){
+    const int16_t * mono = (const int16_t *) words;
+    uint32_t magnitudes = 0;
+
+    for (int i = MONO ? frames - 1 : 0; MONO ? i >= 0 : i < (int)frames; MONO ? i-- : i++){
+        int32_t left, right;
+        if (MONO){
+            left = right = mono[i];
+        } else {
+            uint32_t word = words[i];
+            left = (int16_t)(word & 0xffff);
+            right = (int16_t)(word >> 16);
+        }
+
+        if (tap){
+#ifdef EFFECT_TAP_DOWNMIX
+            // both channels get the mid signal, for effects that don't care
+            // about stereo
+            int16_t mid = (left + right) >> 1;
+            tap[2 * i] = mid;
+            tap[2 * i + 1] = mid;
+#else
+            tap[2 * i] = left;
+            tap[2 * i + 1] = right;
+#endif
+        }
+
+        uint16_t left_magnitude = left < 0 ? -left : left;
+        uint16_t right_magnitude = right < 0 ? -right : right;
+        if (left_magnitude > levels.peak[0]) levels.peak[0] = left_magnitude;
+        if (right_magnitude > levels.peak[1]) levels.peak[1] = right_magnitude;
+        magnitudes |= left_magnitude | right_magnitude;
+        levels.sum_squares[0] += uint32_t(left * left) >> 8;
+        levels.sum_squares[1] += uint32_t(right * right) >> 8;
+
+        int32_t gain = (gain_q23 + gain_step * i) >> 8;
+        words[i] = (uint16_t)((left * gain) >> 15) | ((uint32_t)((right * gain) >> 15) << 16);
+    }
+    levels.samples += frames;
+    return magnitudes;
 }
 
 static void btstack_audio_pico_sink_fill_buffers(void){
@@ -171,56 +544,114 @@ static void btstack_audio_pico_sink_fill_buffers(void){
             break;
         }
 
-        if (!gpio_get(Display::SWITCH_A)) {
-            current_effect = 0;
-        }
+        unsigned int frames = btstack_audio_pico_profile->buffer_frames;
+        unsigned int sample_count = frames * 2;
 
-        if (!gpio_get(Display::SWITCH_B)) {
-            current_effect = 1;
+        int16_t * buffer16 = (int16_t *) audio_buffer->buffer->bytes;
+        (*playback_callback)(buffer16, frames);
+
+        // the effects get a copy of this buffer, as part of a block to draw
+        // when it's heard. If they've fallen that far behind it's dropped
+        btstack_audio_pico_latency_us = btstack_audio_pico_output_latency_us();
+        EffectQueue::Block * block = effect_queue.back();
+        int16_t * effect_buf = NULL;
+        AudioLevels discarded;
+        AudioLevels & levels = block ? block->levels : discarded;
+        if (block){
+            if (btstack_audio_pico_effect_fill == 0){
+                block->due_us = time_us_32() + btstack_audio_pico_latency_us;
+                block->levels.reset();
+            }
+            effect_buf = &block->samples[btstack_audio_pico_effect_fill];
         }
 
-        int16_t * buffer16 = (int16_t *) audio_buffer->buffer->bytes;
-        (*playback_callback)(buffer16, audio_buffer->max_sample_count);
+        // ramp from the gain the last buffer ended on to the one for the
+        // current volume, in Q23 so small steps over a buffer aren't lost
+        int32_t target_gain = btstack_audio_pico_gain_lut[btstack_volume & 0x7f];
+        int32_t gain_q23 = btstack_audio_pico_gain * 256;
+        int32_t gain_step = (target_gain - btstack_audio_pico_gain) * 256 / (int32_t)frames;
+        btstack_audio_pico_gain = target_gain;
 
-#ifndef EFFECTS_ON_CORE1
-        effects[current_effect]->update(buffer16, SAMPLE_COUNT);
-#endif
+        uint32_t * words = (uint32_t *) audio_buffer->buffer->bytes;
+        uint32_t magnitudes;
+        if (btstack_audio_pico_channel_count == 1){
+            magnitudes = btstack_audio_pico_process_buffer<true>(words, frames, gain_q23, gain_step, effect_buf, levels);
+        } else {
+            magnitudes = btstack_audio_pico_process_buffer<false>(words, frames, gain_q23, gain_step, effect_buf, levels);
+        }
 
-#ifdef EFFECTS_ON_CORE1
-        mutex_enter_blocking(&core1_effect_update);
-#endif
-        for (auto i = 0u; i < SAMPLE_COUNT; i++) {
-#ifdef EFFECTS_ON_CORE1
-            effect_buf[i] = buffer16[i];
-#endif
-            buffer16[i] = (int32_t(buffer16[i]) * int32_t(btstack_volume)) >> 8;
+        if (magnitudes >= SILENCE_LEVEL){
+            btstack_audio_pico_silent_frames = 0;
+        } else if (btstack_audio_pico_silent_frames < btstack_audio_pico_silence_hold_frames){
+            btstack_audio_pico_silent_frames += frames;
         }
-#ifdef EFFECTS_ON_CORE1
-        mutex_exit(&core1_effect_update);
-#endif
+        btstack_audio_pico_set_silenced(btstack_audio_pico_silent_frames >= btstack_audio_pico_silence_hold_frames);
 
-        // duplicate samples for mono
-        if (btstack_audio_pico_channel_count == 1){
-            int16_t i;
-            for (i = SAMPLE_COUNT - 1 ; i >= 0; i--){
-                buffer16[2*i  ] = buffer16[i];
-                buffer16[2*i+1] = buffer16[i];
+        if (btstack_audio_pico_eq_enabled){
+            uint32_t start = time_us_32();
+            btstack_audio_pico_equaliser.process(words, frames);
+            btstack_audio_pico_eq_us += time_us_32() - start;
+            btstack_audio_pico_eq_buffers++;
+        }
+
+        // this buffer hasn't been queued yet, so unmuting now is in time
+        // for it. Muting for the volume waits for what's queued to play out
+        if (target_gain != 0){
+            btstack_audio_pico_silent_buffers = 0;
+        } else if (btstack_audio_pico_silent_buffers <= btstack_audio_pico_profile->buffer_count){
+            btstack_audio_pico_silent_buffers++;
+        }
+        btstack_audio_pico_set_muted(btstack_audio_pico_silenced || btstack_audio_pico_silent_buffers > btstack_audio_pico_profile->buffer_count);
+
+        if (btstack_audio_pico_silenced){
+            // nothing to show, don't queue the block for the effects
+            btstack_audio_pico_effect_fill = 0;
+        } else if (block){
+            btstack_audio_pico_effect_fill += sample_count;
+            if (btstack_audio_pico_effect_fill == SAMPLE_COUNT){
+                effect_queue.push();
+                btstack_audio_pico_effect_fill = 0;
             }
         }
 
-        audio_buffer->sample_count = audio_buffer->max_sample_count;
+        audio_buffer->sample_count = frames;
         give_audio_buffer(btstack_audio_pico_audio_buffer_pool, audio_buffer);
     }
+
+#ifndef EFFECTS_OWN_LOOP
+    btstack_audio_pico_schedule_effects();
+#endif
 }
 
-static void driver_timer_handler_sink(btstack_timer_source_t * ts){
+static void btstack_audio_pico_govern_clock(void){
+    // cycles there are in a block at the streaming clock
+    uint32_t block_us = (SAMPLE_COUNT / 2) * 1000000u / btstack_audio_pico_audio_format.sample_freq;
+    uint64_t budget = (uint64_t)block_us * CLOCK_LEVELS[CLOCK_LEVEL_STREAMING].sys_khz / 1000u;
+    uint64_t render = btstack_audio_pico_render_cycles;
+
+    unsigned int level = clock_governor_get_level();
+    if (level == CLOCK_LEVEL_STREAMING && render * 100 > budget * RENDER_BOOST_PERCENT){
+        clock_governor_set_level(CLOCK_LEVEL_BOOST);
+    } else if (level == CLOCK_LEVEL_BOOST && render * 100 < budget * RENDER_RELAX_PERCENT){
+        clock_governor_set_level(CLOCK_LEVEL_STREAMING);
+    }
+}
 
-    // refill
-    btstack_audio_pico_sink_fill_buffers();
+// runs after the audio_i2s handler on the same interrupt, which has by
+// then moved on to its next buffer and handed any producer buffer it's
+// finished with back to the pool
+static void __isr btstack_audio_pico_dma_irq_handler(void){
+    btstack_run_loop_poll_data_sources_from_irq();
+}
+
+static void driver_data_source_handler_sink(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    (void) ds;
+    if (callback_type != DATA_SOURCE_CALLBACK_POLL) return;
 
-    // re-set timer
-    btstack_run_loop_set_timer(ts, DRIVER_POLL_INTERVAL_MS);
-    btstack_run_loop_add_timer(ts);
+    // refill whatever has been freed, does nothing if the poll was for
+    // some other source
+    btstack_audio_pico_sink_fill_buffers();
+    btstack_audio_pico_govern_clock();
 }
 
 static int btstack_audio_pico_sink_init(
@@ -231,11 +662,12 @@ static int btstack_audio_pico_sink_init(
     btstack_assert(playback != NULL);
     btstack_assert(channels != 0);
 
-    gpio_init(22); gpio_set_dir(22, GPIO_OUT); gpio_put(22, true);
+    gpio_init(Display::MUTE); gpio_set_dir(Display::MUTE, GPIO_OUT); gpio_put(Display::MUTE, true);
+    btstack_audio_pico_muted = false;
 
     playback_callback  = playback;
 
-    btstack_audio_pico_audio_buffer_pool = init_audio(samplerate, channels);
+    init_audio(samplerate, channels);
 
     return 0;
 }
@@ -245,13 +677,38 @@ static void btstack_audio_pico_sink_set_volume(uint8_t volume){
 }
 
 static void btstack_audio_pico_sink_start_stream(void){
+    // hold back the buffers this profile doesn't use
+    const LatencyProfile * profile = btstack_audio_pico_profile;
+    while (btstack_audio_pico_parked_count < LATENCY_MAX_BUFFER_COUNT - profile->buffer_count){
+        audio_buffer_t * audio_buffer = take_audio_buffer(btstack_audio_pico_audio_buffer_pool, false);
+        if (audio_buffer == NULL) break;
+        btstack_audio_pico_parked[btstack_audio_pico_parked_count++] = audio_buffer;
+    }
+    btstack_audio_pico_effect_fill = 0;
+    // fade in from silence
+    btstack_audio_pico_gain = 0;
+    btstack_audio_pico_equaliser.reset();
+    btstack_audio_pico_eq_us = 0;
+    btstack_audio_pico_eq_buffers = 0;
+    btstack_audio_pico_render_cycles = 0;
+    btstack_audio_pico_silent_frames = 0;
+#ifdef EFFECTS_OWN_LOOP
+    btstack_audio_pico_effects_set_running(true);
+#else
+    btstack_audio_pico_restart_effects(true);
+#endif
+    btstack_audio_pico_set_silenced(false);
+    clock_governor_set_level(CLOCK_LEVEL_STREAMING);
+    printf("Audio: %s profile, %u buffers of %u frames\n", profile->name, profile->buffer_count, profile->buffer_frames);
+
     // pre-fill HAL buffers
     btstack_audio_pico_sink_fill_buffers();
 
-    // start timer
-    btstack_run_loop_set_timer_handler(&driver_timer_sink, &driver_timer_handler_sink);
-    btstack_run_loop_set_timer(&driver_timer_sink, DRIVER_POLL_INTERVAL_MS);
-    btstack_run_loop_add_timer(&driver_timer_sink);
+    // refill as the i2s frees buffers
+    btstack_run_loop_set_data_source_handler(&driver_data_source_sink, &driver_data_source_handler_sink);
+    btstack_run_loop_enable_data_source_callbacks(&driver_data_source_sink, DATA_SOURCE_CALLBACK_POLL);
+    btstack_run_loop_add_data_source(&driver_data_source_sink);
+    irq_add_shared_handler(DMA_IRQ_0 + PICO_AUDIO_I2S_DMA_IRQ, btstack_audio_pico_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY);
 
     // state
     btstack_audio_pico_sink_active = true;
@@ -262,12 +719,41 @@ static void btstack_audio_pico_sink_start_stream(void){
 static void btstack_audio_pico_sink_stop_stream(void){
     audio_i2s_set_enabled(false);
 
-    // stop timer
-    btstack_run_loop_remove_timer(&driver_timer_sink);
+    // stop refilling
+    irq_remove_handler(DMA_IRQ_0 + PICO_AUDIO_I2S_DMA_IRQ, btstack_audio_pico_dma_irq_handler);
+    btstack_run_loop_remove_data_source(&driver_data_source_sink);
+#ifdef EFFECTS_OWN_LOOP
+    btstack_audio_pico_effects_set_running(false);
+#else
+    btstack_run_loop_remove_timer(&effect_timer);
+    effect_timer_active = false;
+    btstack_audio_pico_restart_effects(false);
+#endif
     // state
     btstack_audio_pico_sink_active = false;
 
-    display.clear();
+    while (btstack_audio_pico_parked_count > 0){
+        queue_free_audio_buffer(btstack_audio_pico_audio_buffer_pool, btstack_audio_pico_parked[--btstack_audio_pico_parked_count]);
+    }
+
+    printf("Display: %lu frames, %.1fHz\n", (unsigned long)display.get_frame_count(), display.get_refresh_rate());
+    printf("Audio: %luus output latency\n", (unsigned long)btstack_audio_pico_latency_us);
+    if (btstack_audio_pico_eq_buffers > 0){
+        // as a share of the time it takes to play a buffer
+        const LatencyProfile * profile = btstack_audio_pico_profile;
+        uint32_t us = btstack_audio_pico_eq_us / btstack_audio_pico_eq_buffers;
+        uint32_t buffer_us = (uint64_t)profile->buffer_frames * 1000000u / btstack_audio_pico_audio_format.sample_freq;
+        printf("EQ: %u stages, %.1fdB headroom, %lu cycles per buffer, %lu%% of the buffer's time\n",
+            btstack_audio_pico_equaliser.get_stage_count(), btstack_audio_pico_equaliser.get_headroom_db(),
+            (unsigned long)((uint64_t)us * clock_get_hz(clk_sys) / 1000000u), (unsigned long)(us * 100 / buffer_us));
+    }
+    printf("Effects: %lu cycles per block\n", (unsigned long)btstack_audio_pico_render_cycles);
+
+    btstack_audio_pico_profile = btstack_audio_pico_requested_profile;
+    clock_governor_set_level(CLOCK_LEVEL_IDLE);
+
+    // and nothing to show until the next stream
+    btstack_audio_pico_set_silenced(true);
 }
 
 static void btstack_audio_pico_sink_close(void){
@@ -288,3 +774,37 @@ static const btstack_audio_sink_t btstack_audio_pico_sink = {
 const btstack_audio_sink_t * btstack_audio_pico_sink_get_instance(void){
     return &btstack_audio_pico_sink;
 }
+
+const LatencyProfile * btstack_audio_pico_get_latency_profile(void){
+    return btstack_audio_pico_profile;
+}
+
+void btstack_audio_pico_set_eq_enabled(bool enabled){
+    btstack_audio_pico_eq_enabled = enabled;
+    if (enabled){
+        btstack_audio_pico_equaliser.reset();
+    }
+    printf("EQ: %s\n", enabled ? "on" : "off");
+}
+
+bool btstack_audio_pico_get_eq_enabled(void){
+    return btstack_audio_pico_eq_enabled;
+}
+
+void btstack_audio_pico_set_latency_profile(unsigned int index){
+    if (index >= LATENCY_PROFILE_COUNT) return;
+    btstack_audio_pico_requested_profile = &LATENCY_PROFILES[index];
+    if (!btstack_audio_pico_sink_active){
+        btstack_audio_pico_profile = btstack_audio_pico_requested_profile;
+    }
+    printf("Audio: %s profile from the next stream\n", btstack_audio_pico_requested_profile->name);
+}
+
+// track info from the avrcp controller, shown by the now playing overlay
+void btstack_audio_pico_set_now_playing_title(const uint8_t * value, uint16_t length){
+    now_playing.set_title(value, length);
+}
+
+void btstack_audio_pico_set_now_playing_artist(const uint8_t * value, uint16_t length){
+    now_playing.set_artist(value, length);
+}
@@ -0,0 +1,201 @@
+#include "buttons.hpp"
+
+#include "btstack_run_loop.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "pico/stdlib.h"
+
+#include "display.hpp"
+#include "spsc_ring.hpp"
+
+static constexpr uint32_t     BUTTONS_EDGES = GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE;
+static constexpr unsigned int BUTTONS_MAX_HANDLERS = 4;
+
+static const uint8_t buttons_pins[BUTTON_COUNT] = {
+    Display::SWITCH_A,
+    Display::SWITCH_B,
+    Display::SWITCH_C,
+    Display::SWITCH_D,
+    Display::SWITCH_SLEEP,
+    Display::SWITCH_BRIGHTNESS_UP,
+    Display::SWITCH_BRIGHTNESS_DOWN,
+    Display::SWITCH_VOLUME_UP,
+    Display::SWITCH_VOLUME_DOWN,
+};
+
+// The first edge from a pin, as the interrupt saw it. The pin is masked
+// until the run loop has looked at it, so there's never more than one
+// queued for each button and the queue can't fill
+typedef struct {
+    uint8_t  button;
+    uint32_t time_us;
+} button_edge_t;
+
+static SpscRing<BUTTON_COUNT * sizeof(button_edge_t)> buttons_edges;
+
+typedef struct {
+    bool     settling;
+    uint32_t settled_us;    // when to look at the pin again
+    bool     down;
+    bool     held;
+    uint32_t repeat_us;     // when the next hold or repeat is due
+} button_state_t;
+
+static button_state_t        buttons_state[BUTTON_COUNT];
+
+static button_handler_t      buttons_handlers[BUTTONS_MAX_HANDLERS];
+static unsigned int          buttons_handler_count;
+
+static btstack_data_source_t buttons_data_source;
+static btstack_timer_source_t buttons_timer;
+static bool                  buttons_timer_active;
+
+static void buttons_timer_handler(btstack_timer_source_t * ts);
+
+static void buttons_emit(unsigned int button, button_event_t event){
+    for (unsigned int i = 0; i < buttons_handler_count; i++){
+        buttons_handlers[i](button, event);
+    }
+}
+
+static void __isr buttons_irq_handler(void){
+    uint32_t now = time_us_32();
+    bool queued = false;
+    for (unsigned int button = 0; button < BUTTON_COUNT; button++){
+        uint pin = buttons_pins[button];
+        uint32_t events = gpio_get_irq_event_mask(pin) & BUTTONS_EDGES;
+        if (events == 0) continue;
+
+        // the rest are the contacts bouncing
+        gpio_set_irq_enabled(pin, BUTTONS_EDGES, false);
+        gpio_acknowledge_irq(pin, events);
+
+        button_edge_t edge = {(uint8_t)button, now};
+        buttons_edges.write(&edge, sizeof(edge));
+        queued = true;
+    }
+    if (queued){
+        btstack_run_loop_poll_data_sources_from_irq();
+    }
+}
+
+// Looks at every pin that has settled, turns changes into events and
+// works out when anything next needs doing
+static void buttons_update(void){
+    uint32_t now = time_us_32();
+    int32_t next_us = INT32_MAX;
+
+    for (unsigned int button = 0; button < BUTTON_COUNT; button++){
+        button_state_t * state = &buttons_state[button];
+        uint pin = buttons_pins[button];
+
+        if (state->settling){
+            int32_t wait_us = state->settled_us - now;
+            if (wait_us > 0){
+                if (wait_us < next_us) next_us = wait_us;
+                continue;
+            }
+
+            // any edge from here on raises the interrupt again, and is
+            // caught by another look once it has settled
+            state->settling = false;
+            gpio_acknowledge_irq(pin, BUTTONS_EDGES);
+            gpio_set_irq_enabled(pin, BUTTONS_EDGES, true);
+
+            bool down = !gpio_get(pin);
+            if (down != state->down){
+                state->down = down;
+                if (down){
+                    state->held = false;
+                    state->repeat_us = now + BUTTONS_HOLD_MS * 1000;
+                    buttons_emit(button, BUTTON_PRESSED);
+                } else {
+                    if (!state->held){
+                        buttons_emit(button, BUTTON_CLICKED);
+                    }
+                    buttons_emit(button, BUTTON_RELEASED);
+                }
+            }
+        }
+
+        if (!state->down) continue;
+
+        int32_t wait_us = state->repeat_us - now;
+        if (wait_us <= 0){
+            buttons_emit(button, state->held ? BUTTON_REPEATED : BUTTON_HELD);
+            state->held = true;
+            state->repeat_us += BUTTONS_REPEAT_MS * 1000;
+            wait_us = state->repeat_us - now;
+            if (wait_us < 0) wait_us = 0;
+        }
+        if (wait_us < next_us) next_us = wait_us;
+    }
+
+    if (next_us == INT32_MAX) return;
+
+    // a new edge may want an earlier look than the one already waiting
+    if (buttons_timer_active){
+        btstack_run_loop_remove_timer(&buttons_timer);
+    }
+    btstack_run_loop_set_timer_handler(&buttons_timer, &buttons_timer_handler);
+    btstack_run_loop_set_timer(&buttons_timer, (next_us + 999) / 1000);
+    btstack_run_loop_add_timer(&buttons_timer);
+    buttons_timer_active = true;
+}
+
+static void buttons_timer_handler(btstack_timer_source_t * ts){
+    (void) ts;
+    buttons_timer_active = false;
+    buttons_update();
+}
+
+static void buttons_data_source_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    (void) ds;
+    if (callback_type != DATA_SOURCE_CALLBACK_POLL) return;
+
+    // polled for every interrupt that wakes the run loop, usually with
+    // nothing queued
+    if (buttons_edges.bytes_available() == 0) return;
+
+    button_edge_t edge;
+    while (buttons_edges.read(&edge, sizeof(edge)) == sizeof(edge)){
+        button_state_t * state = &buttons_state[edge.button];
+        state->settling = true;
+        state->settled_us = edge.time_us + BUTTONS_DEBOUNCE_MS * 1000;
+    }
+    buttons_update();
+}
+
+// anything already down is left alone until it has been let go
+void buttons_init(void){
+    uint32_t mask = 0;
+    for (unsigned int button = 0; button < BUTTON_COUNT; button++){
+        uint pin = buttons_pins[button];
+        gpio_init(pin);
+        gpio_pull_up(pin);
+        mask |= 1u << pin;
+    }
+
+    btstack_run_loop_set_data_source_handler(&buttons_data_source, &buttons_data_source_handler);
+    btstack_run_loop_enable_data_source_callbacks(&buttons_data_source, DATA_SOURCE_CALLBACK_POLL);
+    btstack_run_loop_add_data_source(&buttons_data_source);
+
+    // a raw handler rather than the gpio callback, which is shared by the
+    // whole bank and may be wanted elsewhere
+    gpio_add_raw_irq_handler_masked(mask, buttons_irq_handler);
+    for (unsigned int button = 0; button < BUTTON_COUNT; button++){
+        gpio_acknowledge_irq(buttons_pins[button], BUTTONS_EDGES);
+        gpio_set_irq_enabled(buttons_pins[button], BUTTONS_EDGES, true);
+    }
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+void buttons_add_handler(button_handler_t handler){
+    if (buttons_handler_count < BUTTONS_MAX_HANDLERS){
+        buttons_handlers[buttons_handler_count++] = handler;
+    }
+}
+
+bool buttons_is_down(unsigned int button){
+    return button < BUTTON_COUNT && buttons_state[button].down;
+}
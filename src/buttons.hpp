@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+
+// The board's buttons, debounced and handed out as events on the btstack
+// run loop. Nothing reads a pin until it has moved: each edge raises an
+// interrupt that masks the pin and queues the edge, and the run loop takes
+// a look once the contacts have had BUTTONS_DEBOUNCE_MS to settle.
+enum {
+    BUTTON_A,
+    BUTTON_B,
+    BUTTON_C,
+    BUTTON_D,
+    BUTTON_SLEEP,
+    BUTTON_BRIGHTNESS_UP,
+    BUTTON_BRIGHTNESS_DOWN,
+    BUTTON_VOLUME_UP,
+    BUTTON_VOLUME_DOWN,
+    BUTTON_COUNT
+};
+
+typedef enum {
+    BUTTON_PRESSED,     // as soon as it's down
+    BUTTON_CLICKED,     // let go before it was held
+    BUTTON_HELD,        // still down after BUTTONS_HOLD_MS
+    BUTTON_REPEATED,    // every BUTTONS_REPEAT_MS while held after that
+    BUTTON_RELEASED,    // let go, after any of the above
+} button_event_t;
+
+static constexpr uint32_t BUTTONS_DEBOUNCE_MS = 20;
+static constexpr uint32_t BUTTONS_HOLD_MS     = 600;
+static constexpr uint32_t BUTTONS_REPEAT_MS   = 150;
+
+typedef void (*button_handler_t)(unsigned int button, button_event_t event);
+
+// on the run loop's core, the pins' interrupts are enabled there
+void buttons_init(void);
+
+// every handler sees every event
+void buttons_add_handler(button_handler_t handler);
+
+bool buttons_is_down(unsigned int button);
@@ -0,0 +1,77 @@
+#include "clock_governor.hpp"
+
+#include "hardware/clocks.h"
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+static unsigned int clock_governor_level = CLOCK_LEVEL_COUNT;
+static bool         clock_governor_fixed;
+
+static PIO          clock_governor_i2s_pio;
+static unsigned int clock_governor_i2s_sm;
+static uint32_t     clock_governor_i2s_freq;
+
+// the same sum audio_i2s does, which it only does again when the sample
+// rate changes
+static void clock_governor_update_i2s(void){
+    if (clock_governor_i2s_freq == 0) return;
+    uint32_t divider = clock_get_hz(clk_sys) * 4 / clock_governor_i2s_freq;
+    pio_sm_set_clkdiv_int_frac(clock_governor_i2s_pio, clock_governor_i2s_sm, divider >> 8u, divider & 0xffu);
+}
+
+void clock_governor_set_level(unsigned int level){
+    if (level >= CLOCK_LEVEL_COUNT || level == clock_governor_level || clock_governor_fixed) return;
+
+    const ClockLevel * to = &CLOCK_LEVELS[level];
+    bool faster = to->sys_khz > clock_get_hz(clk_sys) / 1000;
+
+    // nothing can talk to the cyw43 while its spi clock moves. There's no
+    // context yet when called before it's initialised, and nothing to stop
+    async_context_t * context = cyw43_arch_async_context();
+    if (context) async_context_acquire_lock_blocking(context);
+
+    // the voltage goes up and the spi slows down before the clock goes
+    // up, and the other way round after it comes down
+    if (faster){
+        vreg_set_voltage(to->voltage);
+        busy_wait_us(1000);
+        cyw43_set_pio_clock_divisor(to->cyw43_divider, 0);
+    }
+
+    set_sys_clock_khz(to->sys_khz, true);
+
+    // clk_peri follows clk_sys by default, keep it (and the uart) still
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, 48 * MHZ, 48 * MHZ);
+
+    clock_governor_update_i2s();
+
+    if (!faster){
+        cyw43_set_pio_clock_divisor(to->cyw43_divider, 0);
+        vreg_set_voltage(to->voltage);
+    }
+
+    if (context) async_context_release_lock(context);
+
+    clock_governor_level = level;
+    printf("Clock: %s, %lukHz\n", to->name, (unsigned long)to->sys_khz);
+}
+
+unsigned int clock_governor_get_level(void){
+    return clock_governor_level;
+}
+
+void clock_governor_set_i2s(PIO pio, unsigned int sm, uint32_t sample_freq){
+    clock_governor_i2s_pio = pio;
+    clock_governor_i2s_sm = sm;
+    clock_governor_i2s_freq = sample_freq;
+    clock_governor_update_i2s();
+}
+
+void clock_governor_init(void){
+#ifdef USE_FREERTOS
+    clock_governor_set_level(CLOCK_LEVEL_STREAMING);
+    clock_governor_fixed = true;
+#else
+    clock_governor_set_level(CLOCK_LEVEL_IDLE);
+#endif
+}
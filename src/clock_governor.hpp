@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include "hardware/pio.h"
+#include "hardware/vreg.h"
+
+// System clock levels. Each one is something the PLL can make exactly from
+// the 12MHz crystal that also gives an I2S divider (clk_sys * 4 / sample
+// rate, in 1/256ths) within a few ppm of exact at both 44.1kHz and 48kHz.
+// Nothing from the crystal is exact at 44.1kHz, these are the closest.
+struct ClockLevel {
+    const char * name;
+    uint32_t sys_khz;
+    enum vreg_voltage voltage;
+    uint16_t cyw43_divider;     // keeps the cyw43 spi clock at or under 62.5MHz
+};
+
+enum {
+    CLOCK_LEVEL_IDLE,
+    CLOCK_LEVEL_STREAMING,
+    CLOCK_LEVEL_BOOST,
+    CLOCK_LEVEL_COUNT
+};
+
+static const ClockLevel CLOCK_LEVELS[CLOCK_LEVEL_COUNT] = {
+    // nothing playing: 48kHz exact, 44.1kHz 142ppm fast
+    {"idle",      76800,  VREG_VOLTAGE_1_10, 2},
+    // 48kHz exact, 44.1kHz 3.7ppm fast
+    {"streaming", 122400, VREG_VOLTAGE_1_10, 2},
+    // for heavy effects: 48kHz exact, 44.1kHz 1.5ppm fast
+    {"boost",     199200, VREG_VOLTAGE_1_20, 4},
+};
+
+// Starts at the idle level. In the FreeRTOS build the scheduler's tick is
+// counted in system clocks, so it starts at the streaming level and stays
+// there.
+void clock_governor_init(void);
+
+void clock_governor_set_level(unsigned int level);
+unsigned int clock_governor_get_level(void);
+
+// the I2S state machine to keep at sample_freq whenever the clock changes,
+// sample_freq 0 for none
+void clock_governor_set_i2s(PIO pio, unsigned int sm, uint32_t sample_freq);
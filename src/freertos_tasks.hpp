@@ -0,0 +1,20 @@
+#pragma once
+#include "FreeRTOS.h"
+#include "task.h"
+
+// Where everything runs in the FreeRTOS build, and what gives way to what.
+//
+// btstack runs in the cyw43 driver's task, pinned to core0, along with the
+// audio refill, which only copies out audio that's already decoded. The
+// sbc decoder and the effects share core1 with the decoder above the
+// effects, so drawing only ever gets the time audio doesn't need.
+#define BTSTACK_TASK_PRIORITY   (tskIDLE_PRIORITY + 3)
+#define BTSTACK_TASK_CORES      (1u << 0)
+
+#define DECODE_TASK_PRIORITY    (tskIDLE_PRIORITY + 4)
+#define DECODE_TASK_CORES       (1u << 1)
+#define DECODE_TASK_STACK_SIZE  1024
+
+#define RENDER_TASK_PRIORITY    (tskIDLE_PRIORITY + 1)
+#define RENDER_TASK_CORES       (1u << 1)
+#define RENDER_TASK_STACK_SIZE  1024
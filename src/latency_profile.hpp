@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+// End to end audio latency settings, chosen together: how much audio the
+// output keeps queued (producer pool depth and buffer size) and how many
+// SBC frames the A2DP sink holds to ride out gaps in the radio link.
+// Lower latency keeps the lights and any lip-sync tighter, more buffering
+// survives a busier 2.4GHz band.
+struct LatencyProfile {
+    const char * name;
+    uint8_t  buffer_count;      // producer pool buffers in use
+    uint16_t buffer_frames;     // stereo frames per buffer
+    uint16_t sbc_frames_min;    // start playing at, and stretch below, this
+    uint16_t sbc_frames_max;    // compress above this
+};
+
+static constexpr unsigned int LATENCY_PROFILE_LOW      = 0;
+static constexpr unsigned int LATENCY_PROFILE_BALANCED = 1;
+static constexpr unsigned int LATENCY_PROFILE_ROBUST   = 2;
+static constexpr unsigned int LATENCY_PROFILE_COUNT    = 3;
+
+static constexpr LatencyProfile LATENCY_PROFILES[LATENCY_PROFILE_COUNT] = {
+    {"low latency", 3, 256, 20,  30},
+    {"balanced",    3, 512, 60,  80},
+    {"robust",      4, 512, 90, 110},
+};
+
+// the largest of each, storage is sized for these
+static constexpr unsigned int LATENCY_MAX_BUFFER_COUNT  = 4;
+static constexpr unsigned int LATENCY_MAX_BUFFER_FRAMES = 512;
+static constexpr unsigned int LATENCY_MAX_SBC_FRAMES    = 110;
+
+// profile used from power on, can be set at build time
+#ifndef LATENCY_PROFILE
+#define LATENCY_PROFILE LATENCY_PROFILE_BALANCED
+#endif
+
+// in btstack_audio_pico.cpp. The profile can be changed at any time but
+// only takes effect when the next stream starts
+const LatencyProfile * btstack_audio_pico_get_latency_profile(void);
+void btstack_audio_pico_set_latency_profile(unsigned int index);
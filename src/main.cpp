@@ -7,16 +7,40 @@
 #include "btstack_run_loop.h"
 #include "pico/stdlib.h"
 #include "bluetooth/common.h"
-#include "hardware/vreg.h"
+#include "clock_governor.hpp"
 
+#ifdef USE_FREERTOS
+#include "pico/async_context_freertos.h"
+#include "pico/cyw43_arch.h"
+#include "freertos_tasks.hpp"
+
+static void main_task(void * params) {
+    (void) params;
+
+    if (picow_bt_example_init() == 0) {
+        // btstack's run loop is the cyw43 driver's async context task
+        async_context_freertos_t *context = (async_context_freertos_t *)cyw43_arch_async_context();
+        vTaskPrioritySet(context->task_handle, BTSTACK_TASK_PRIORITY);
+        vTaskCoreAffinitySet(context->task_handle, BTSTACK_TASK_CORES);
+
+        picow_bt_example_main();
+    }
+
+    vTaskDelete(NULL);
+}
+#endif
 
 int main() {
-    //vreg_set_voltage(VREG_VOLTAGE_1_20);
-    //sleep_ms(10);
-    //set_sys_clock_khz(200000, true);
+    clock_governor_init();
 
     stdio_init_all();
 
+#ifdef USE_FREERTOS
+    TaskHandle_t task;
+    xTaskCreate(main_task, "main", configMINIMAL_STACK_SIZE, NULL, BTSTACK_TASK_PRIORITY, &task);
+    vTaskCoreAffinitySet(task, BTSTACK_TASK_CORES);
+    vTaskStartScheduler();
+#else
     int res = picow_bt_example_init();
     if (res){
         return -1;
@@ -24,4 +48,5 @@ int main() {
 
     picow_bt_example_main();
     btstack_run_loop_execute();
+#endif
 }
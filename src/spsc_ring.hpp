@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// A byte ring with one writer and one reader, possibly on different cores.
+// The writer only moves the tail and the reader only moves the head, so
+// neither needs a lock. One byte is kept free to tell full from empty.
+template<unsigned int CAPACITY>
+class SpscRing {
+    private:
+        static constexpr unsigned int SIZE = CAPACITY + 1;
+
+        uint8_t storage[SIZE];
+        std::atomic<uint32_t> head{0};
+        std::atomic<uint32_t> tail{0};
+
+    public:
+        static constexpr unsigned int capacity() { return CAPACITY; }
+
+        unsigned int bytes_available() const {
+            uint32_t t = tail.load(std::memory_order_acquire);
+            uint32_t h = head.load(std::memory_order_acquire);
+            return t >= h ? t - h : SIZE - h + t;
+        }
+
+        unsigned int bytes_free() const {
+            return CAPACITY - bytes_available();
+        }
+
+        // writer: all of data or, if it won't fit, none of it
+        bool write(const void * data, unsigned int length) {
+            if (length > bytes_free()) return false;
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            unsigned int first = SIZE - t < length ? SIZE - t : length;
+            memcpy(&storage[t], data, first);
+            memcpy(storage, (const uint8_t *)data + first, length - first);
+            t += length;
+            tail.store(t >= SIZE ? t - SIZE : t, std::memory_order_release);
+            return true;
+        }
+
+        // reader: up to length bytes, returns how many it got
+        unsigned int read(void * data, unsigned int length) {
+            unsigned int available = bytes_available();
+            if (length > available) length = available;
+            uint32_t h = head.load(std::memory_order_relaxed);
+            unsigned int first = SIZE - h < length ? SIZE - h : length;
+            memcpy(data, &storage[h], first);
+            memcpy((uint8_t *)data + first, storage, length - first);
+            h += length;
+            head.store(h >= SIZE ? h - SIZE : h, std::memory_order_release);
+            return length;
+        }
+
+        // only while neither side is using the ring
+        void reset() {
+            head.store(0, std::memory_order_relaxed);
+            tail.store(0, std::memory_order_release);
+        }
+};